@@ -0,0 +1,97 @@
+//
+// Checks that the sampler does not allocate once it has warmed up. Global operator new is
+// replaced by one that counts its calls, the model takes enough steps for every buffer of
+// the hot path to reach its full size, and the steps after that must allocate nothing.
+// Run for each kind of step and state width, so a vector added to the hot path later is
+// caught.
+//
+// usage: hcp_alloc_test <network file> [steps]
+//
+
+#include "hierarchical_model.h"
+#include "graph_formats.h"
+#include "parameters.h"
+#include "readgml.h"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+
+namespace {
+    std::atomic<long> allocations(0);
+
+    void *counted_alloc(std::size_t size, std::size_t alignment) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        void *p = (alignment <= alignof(std::max_align_t)) ? std::malloc(size ? size : 1)
+                                                          : std::aligned_alloc(alignment, (size + alignment - 1)/alignment*alignment);
+        if (p == nullptr){
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+
+    struct setup {
+        const char *name;
+        const char *settings;
+    };
+}
+
+void *operator new(std::size_t size) { return counted_alloc(size, 0); }
+void *operator new[](std::size_t size) { return counted_alloc(size, 0); }
+void *operator new(std::size_t size, std::align_val_t alignment) {
+    return counted_alloc(size, static_cast<std::size_t>(alignment));
+}
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+    return counted_alloc(size, static_cast<std::size_t>(alignment));
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+int main(int argc, char* argv[]) {
+    if (argc < 2){
+        std::cerr<<"usage: "<<argv[0]<<" <network file> [steps]"<<std::endl;
+        return EXIT_FAILURE;
+    }
+    long steps = (argc > 2) ? std::stol(argv[2]) : 200000;
+
+    NETWORK network;
+    if (read_graph(&network, argv[1], graph_format::automatic, true, 1) != 0){
+        return EXIT_FAILURE;
+    }
+
+    const setup setups[] = {
+        {"single-group moves", "max_num_groups: 8\n"},
+        {"heat-bath moves", "max_num_groups: 8\ngibbs_fraction: 0.05\n"},
+        {"heat-bath moves one group at a time", "max_num_groups: 8\ngibbs_fraction: 0.05\ngibbs_max_groups: 1\n"},
+        {"neighbour histograms", "max_num_groups: 8\nneighbour_histograms: true\ngibbs_fraction: 0.05\n"},
+        {"64-bit states", "max_num_groups: 64\n"},
+        {"wide states", "max_num_groups: 128\ngibbs_fraction: 0.05\n"},
+    };
+    int failures = 0;
+    for (const setup &s : setups){
+        std::istringstream settings(std::string(s.settings) + "seed: 1\nread_threads: 1\n");
+        parameters params(settings);
+        std::unique_ptr<hierarchical_model> model = make_model(params, network, 1);
+        for (long i = 0; i < steps; ++i){
+            model->get_groups();
+        }
+        long before = allocations.load();
+        for (long i = 0; i < steps; ++i){
+            model->get_groups();
+        }
+        long allocated = allocations.load() - before;
+        std::cout<<s.name<<": "<<allocated<<" allocation(s) in "<<steps<<" steps"<<std::endl;
+        failures += (allocated != 0);
+    }
+    free_network(&network);
+    return failures ? EXIT_FAILURE : 0;
+}
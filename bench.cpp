@@ -0,0 +1,368 @@
+//
+// Benchmarks of the sampler's hot paths, repeatable from one build to the next. A network
+// with a planted nested core-periphery structure is generated in memory (see
+// planted_network.h), or read from a file, and the model is set up on it with the
+// planted cores as its groups. Each benchmark is run a few times and the best time is
+// kept:
+//
+//   generate          generating and building the planted network, per edge
+//   read_edge_list    reading the network back from an edge list file, per edge
+//   setup             setting up the model and counting its edges and pairs, per node
+//   log_factorial     filling the model's table of ln(n!), per entry, with its size in
+//                     bytes
+//   hcg               the highest common slot of the ends of every adjacency entry, per entry
+//   update_hcg_props  flipping a random group of a random node, updating the counts and
+//                     undoing it, per flip
+//   calc_loglike      the log-likelihood from the counts, per call
+//   group_moves       inserting an empty group at a random position and removing it, per pair
+//   steps             sampler steps from the planted state, per step
+//   tempering_plain   a chain from random groups, per step, with the effective samples
+//                     of its log-likelihood per second
+//   tempering_ladder  the same with parallel tempering over a geometric ladder, per step
+//                     of every replica, with the effective samples at temperature 1 per
+//                     second
+//
+// The two tempering runs keep a sample every 1/2000 of the run after discarding its
+// first half, and run their replicas on the given threads, so with fewer threads than
+// temperatures the ladder pays for every replica in wall time.
+//
+// Results are printed as a table and appended as JSON lines to the out file, one object
+// per benchmark with the network, the state width and the label, so runs of different
+// builds can be put side by side.
+//
+// usage: hcp_bench [key=value ...]
+//   nodes, depth, degree, core_fraction, density_ratio, seed
+//                     the planted network (defaults 100000, 3, 16, 0.25, 4, 1)
+//   graph             a network file to use instead, with random groups
+//   max_num_groups    sets the state width as in hcp (default 8)
+//   steps             the size of each timed loop (default 1000000)
+//   repeats           runs of each benchmark (default 3)
+//   threads           threads to build, read and count with (default all cores)
+//   chain_steps       iterations of each tempering run, 0 to skip them (default 10000000)
+//   temperatures      rungs of the tempering ladder (default 4)
+//   max_temperature   top of the ladder (default 10)
+//   label             a name for the build, such as its commit
+//   out               file the results are appended to (default hcp_bench.jsonl)
+//
+
+#include "chain.h"
+#include "hierarchical_model.h"
+#include "log_factorial.h"
+#include "graph_formats.h"
+#include "parameters.h"
+#include "planted_network.h"
+#include "readgml.h"
+#include "replica_exchange.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    struct result {
+        std::string bench;
+        long long ops;
+        double seconds; // best of the repeats
+        double ess = -1.0; // effective samples of the log-likelihood, for sampling runs
+        long long bytes = -1; // memory taken, for tables
+    };
+
+    // keeps samples from the second half of a run of num_itrs iterations
+    void keep_samples(chain &c, long num_itrs) {
+        c.burn_in = num_itrs/2;
+        c.thinning = std::max(1L, num_itrs/2000);
+        c.report_progress = false;
+    }
+
+    // best wall time of repeats runs of f
+    template <typename F>
+    double best_time(int repeats, F f) {
+        double best = 1e300;
+        for (int r = 0; r < repeats; ++r){
+            auto start = std::chrono::steady_clock::now();
+            f();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    }
+
+    // calls f with the model as the width_model it is
+    template <typename F>
+    void with_width(hierarchical_model &model, F f) {
+        if (auto m = dynamic_cast<width_model<uint8_t>*>(&model)){ f(*m); }
+        else if (auto m = dynamic_cast<width_model<uint16_t>*>(&model)){ f(*m); }
+        else if (auto m = dynamic_cast<width_model<uint32_t>*>(&model)){ f(*m); }
+        else if (auto m = dynamic_cast<width_model<uint64_t>*>(&model)){ f(*m); }
+        else if (auto m = dynamic_cast<width_model<wide_state<2>>*>(&model)){ f(*m); }
+        else if (auto m = dynamic_cast<width_model<wide_state<4>>*>(&model)){ f(*m); }
+        else if (auto m = dynamic_cast<width_model<wide_state<8>>*>(&model)){ f(*m); }
+    }
+
+    template <typename state_t>
+    void bench_width(width_model<state_t> &model, long steps, int repeats, unsigned long seed,
+                     std::vector<result> &results) {
+        const NETWORK &G = model.G;
+        int64_t adjacency = G.offset[G.nvertices];
+
+        std::size_t checksum = 0;
+        double seconds = best_time(repeats, [&]() {
+            for (int u = 0; u < G.nvertices; ++u){
+                for (int64_t e = G.offset[u]; e < G.offset[u+1]; ++e){
+                    checksum += highest_common_slot(model.g[u], model.g[G.target[e]]);
+                }
+            }
+        });
+        results.push_back({"hcg", adjacency, seconds});
+
+        std::mt19937_64 rng(seed);
+        std::vector<std::pair<int, int>> flips;
+        if (model.num_groups > 1){
+            std::uniform_int_distribution<int> node(0, G.nvertices-1);
+            std::uniform_int_distribution<int> group(1, model.num_groups-1);
+            for (long i = 0; i < steps; ++i){
+                flips.emplace_back(node(rng), model.group_slot[group(rng)]);
+            }
+            seconds = best_time(repeats, [&]() {
+                for (const auto &flip : flips){
+                    int u = flip.first;
+                    int slot = flip.second;
+                    state_t before = model.g[u];
+                    model.undo_log.clear();
+                    model.undo_log.push_back({undo_op::state, u, slot, 0});
+                    model.g[u] ^= slot_bit<state_t>(slot);
+                    model.update_hcg_props(u, before, slot);
+                    model.clear_touched_levels();
+                    model.undo_move();
+                }
+            });
+            results.push_back({"update_hcg_props", steps, seconds});
+        }
+
+        double sum = 0.0;
+        seconds = best_time(repeats, [&]() {
+            for (long i = 0; i < steps; ++i){
+                sum += model.calc_loglike();
+            }
+        });
+        results.push_back({"calc_loglike", steps, seconds});
+
+        if (model.num_groups < model.max_num_groups){
+            std::vector<int> positions(steps);
+            for (int &r : positions){
+                r = 1 + rng()%model.num_groups;
+            }
+            seconds = best_time(repeats, [&]() {
+                for (int r : positions){
+                    model.insert_group(r);
+                    model.remove_group(r);
+                }
+            });
+            results.push_back({"group_moves", steps, seconds});
+        }
+
+        seconds = best_time(repeats, [&]() {
+            for (long i = 0; i < steps; ++i){
+                model.get_groups();
+            }
+        });
+        results.push_back({"steps", steps, seconds});
+
+        // keeps the loops from being optimised away
+        if (checksum == 0 && sum == 0.0){
+            std::cout<<"checksum 0"<<std::endl;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::map<std::string, std::string> options;
+    for (int i = 1; i < argc; ++i){
+        std::string arg = argv[i];
+        std::size_t eq = arg.find('=');
+        if (eq == std::string::npos){
+            std::cerr<<"usage: "<<argv[0]<<" [key=value ...]"<<std::endl;
+            return EXIT_FAILURE;
+        }
+        options[arg.substr(0, eq)] = arg.substr(eq+1);
+    }
+    auto option = [&](const std::string &key, const std::string &fallback) {
+        auto it = options.find(key);
+        return (it == options.end()) ? fallback : it->second;
+    };
+
+    planted_options planted;
+    planted.nodes = std::stoi(option("nodes", "100000"));
+    planted.depth = std::stoi(option("depth", "3"));
+    planted.degree = std::stod(option("degree", "16"));
+    planted.core_fraction = std::stod(option("core_fraction", "0.25"));
+    planted.density_ratio = std::stod(option("density_ratio", "4"));
+    planted.seed = std::stoul(option("seed", "1"));
+    std::string graph_path = option("graph", "");
+    int max_num_groups = std::stoi(option("max_num_groups", "8"));
+    long steps = std::stol(option("steps", "1000000"));
+    int repeats = std::stoi(option("repeats", "3"));
+    int threads = std::stoi(option("threads", std::to_string(std::max(1u, std::thread::hardware_concurrency()))));
+    long chain_steps = std::stol(option("chain_steps", "10000000"));
+    int temperatures = std::stoi(option("temperatures", "4"));
+    double max_temperature = std::stod(option("max_temperature", "10"));
+    std::string label = option("label", "");
+    std::string out_path = option("out", "hcp_bench.jsonl");
+    if (!graph_path.empty()){
+        planted.depth = 0;
+    }
+    if (planted.depth+1 > max_num_groups){
+        std::cerr<<"depth "<<planted.depth<<" needs max_num_groups of at least "<<planted.depth+1<<std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<result> results;
+    thread_pool pool(threads);
+    NETWORK network;
+    std::vector<int> level;
+    if (graph_path.empty()){
+        bool built = false;
+        double seconds = best_time(repeats, [&]() {
+            if (built){
+                free_network(&network);
+            }
+            planted_core_periphery(&network, level, planted, pool);
+            built = true;
+        });
+        results.push_back({"generate", network.offset[network.nvertices]/2, seconds});
+    }else{
+        read_graph(&network, graph_path, graph_format::automatic, true, threads);
+    }
+    int64_t edges = network.offset[network.nvertices]/2;
+
+    // the network as an edge list, to time reading it back
+    std::filesystem::path edge_list = std::filesystem::temp_directory_path()/"hcp_bench_edges.txt";
+    {
+        std::ofstream out(edge_list);
+        for (int u = 0; u < network.nvertices; ++u){
+            for (int64_t e = network.offset[u]; e < network.offset[u+1]; ++e){
+                if (u < network.target[e]){
+                    out<<u<<" "<<network.target[e]<<"\n";
+                }
+            }
+        }
+    }
+    double seconds = best_time(repeats, [&]() {
+        NETWORK copy;
+        parse_graph(&copy, edge_list.string(), graph_format::edge_list, true, threads);
+        free_network(&copy);
+    });
+    results.push_back({"read_edge_list", edges, seconds});
+    std::filesystem::remove(edge_list);
+
+    // the model takes the planted cores as its groups: node u is in groups 0..level[u]
+    std::ostringstream settings;
+    settings<<"max_num_groups: "<<max_num_groups<<"\n"<<"initial_num_groups: "<<std::max(2, planted.depth+1)<<"\n"
+            <<"seed: "<<planted.seed<<"\n"<<"read_threads: "<<threads<<"\n";
+    std::istringstream settings_in(settings.str());
+    parameters params(settings_in);
+    std::unique_ptr<hierarchical_model> model;
+    seconds = best_time(repeats, [&]() {
+        model = make_width_model(params, network, planted.seed);
+        if (graph_path.empty()){
+            std::vector<uint64_t> groups(network.nvertices);
+            for (int u = 0; u < network.nvertices; ++u){
+                groups[u] = (2ULL<<level[u]) - 1;
+            }
+            model->set_groups(groups, planted.depth+1);
+        }
+    });
+    results.push_back({"setup", network.nvertices, seconds});
+
+    std::size_t table_size = 0;
+    seconds = best_time(repeats, [&]() {
+        log_factorial table;
+        table_size = table.table_size();
+    });
+    results.push_back({"log_factorial", static_cast<long long>(table_size), seconds, -1.0,
+                       static_cast<long long>(table_size*sizeof(double))});
+
+    with_width(*model, [&](auto &m) { bench_width(m, steps, repeats, planted.seed, results); });
+
+    // the same number of iterations from random groups without and with parallel
+    // tempering, compared by effective samples per second of wall time
+    if (chain_steps > 0){
+        std::ostringstream plain_settings;
+        plain_settings<<"max_num_groups: "<<max_num_groups<<"\n"<<"max_itr: "<<chain_steps<<"\n"
+                      <<"seed: "<<planted.seed<<"\n"<<"read_threads: "<<threads<<"\n";
+        std::istringstream plain_in(plain_settings.str());
+        parameters plain_params(plain_in);
+        chain plain(0, plain_params, network, planted.seed);
+        keep_samples(plain, chain_steps);
+        auto start = std::chrono::steady_clock::now();
+        plain.run();
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        results.push_back({"tempering_plain", chain_steps, seconds, effective_sample_size(plain.own_samples.energies)});
+
+        std::istringstream ladder_in(plain_settings.str() + "num_temperatures: " + std::to_string(temperatures)
+                                     + "\nmax_temperature: " + std::to_string(max_temperature) + "\n");
+        parameters ladder_params(ladder_in);
+        std::vector<std::unique_ptr<replica_exchange>> ensembles;
+        // ensemble 1, since the replicas of ensemble 0 report progress
+        ensembles.push_back(std::make_unique<replica_exchange>(1, ladder_params, network, planted.seed));
+        for (auto &replica : ensembles[0]->replicas){
+            keep_samples(*replica, chain_steps);
+        }
+        start = std::chrono::steady_clock::now();
+        run_replica_exchange(ensembles, pool, chain_steps);
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        results.push_back({"tempering_ladder", chain_steps*static_cast<long long>(ensembles[0]->replicas.size()),
+                           seconds, effective_sample_size(ensembles[0]->samples.energies)});
+        ensembles[0]->print_swap_rates();
+    }
+
+    std::ostringstream common;
+    common<<"\"label\":\""<<label<<"\"";
+    if (graph_path.empty()){
+        common<<",\"network\":\"planted\",\"depth\":"<<planted.depth<<",\"degree\":"<<planted.degree
+              <<",\"core_fraction\":"<<planted.core_fraction<<",\"density_ratio\":"<<planted.density_ratio
+              <<",\"seed\":"<<planted.seed;
+    }else{
+        common<<",\"network\":\""<<graph_path<<"\"";
+    }
+    common<<",\"nodes\":"<<network.nvertices<<",\"edges\":"<<edges<<",\"groups\":"<<model->num_groups
+          <<",\"width\":"<<model->num_slots<<",\"threads\":"<<threads;
+
+    std::ofstream out(out_path, std::ios::app);
+    std::cout<<"bench\tops\tseconds\tns/op\tMops/s"<<std::endl;
+    for (const result &r : results){
+        double ns = 1e9*r.seconds/r.ops;
+        std::cout<<r.bench<<"\t"<<r.ops<<"\t"<<r.seconds<<"\t"<<ns<<"\t"<<1e3/ns<<std::endl;
+        out<<"{"<<common.str()<<",\"bench\":\""<<r.bench<<"\",\"ops\":"<<r.ops<<",\"seconds\":"<<r.seconds
+           <<",\"ns_per_op\":"<<ns<<",\"ops_per_second\":"<<1e9/ns;
+        if (r.bytes >= 0){
+            out<<",\"bytes\":"<<r.bytes;
+        }
+        if (r.ess >= 0.0){
+            out<<",\"ess\":"<<r.ess<<",\"ess_per_second\":"<<r.ess/r.seconds;
+        }
+        out<<"}\n";
+    }
+    for (const result &r : results){
+        if (r.bytes >= 0){
+            std::cout<<r.bench<<": "<<r.bytes<<" bytes"<<std::endl;
+        }
+        if (r.ess >= 0.0){
+            std::cout<<r.bench<<": "<<r.ess<<" effective samples, "<<r.ess/r.seconds<<" per second"<<std::endl;
+        }
+    }
+    std::cout<<"results appended to "<<out_path<<std::endl;
+
+    model.reset();
+    free_network(&network);
+    return 0;
+}
@@ -0,0 +1,262 @@
+//
+// A single Markov chain of the hierarchical model together with the samples it keeps.
+//
+
+#include "chain.h"
+#include "checkpoint.h"
+#include "multilevel_init.h"
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <sstream>
+
+namespace {
+    std::mutex output_lock; // progress reports of different chains must not interleave
+}
+
+void sample_store::add(hierarchical_model &model, long itr) {
+    if (writer){
+        sample_record &record = writer->acquire();
+        record.itr = itr;
+        record.loglike = model.loglike;
+        record.num_groups = model.num_groups;
+        model.get_g(record.g);
+        model.by_group(model.group_size, record.group_size);
+        model.by_group(model.hcg_edges, record.hcg_edges);
+        model.by_group(model.hcg_pairs, record.hcg_pairs);
+        writer->publish();
+    }
+    if (summary){
+        summary->add(model);
+    }
+    energies.push_back(model.loglike);
+    num_groups.push_back(model.num_groups);
+}
+
+chain::chain(int id, const parameters &params, const NETWORK &network, unsigned long seed)
+    : id(id), seed(seed), num_itrs(params.get_max_itr()), report_progress(id == 0),
+      model(make_width_model(params, network, seed)), samples(&own_samples) {}
+
+void chain::start(const parameters &params) {
+    if (use_multilevel_start(params)){
+        multilevel_start(*model, params, seed);
+    }
+}
+
+void sample_store::save_state(std::ostream &out) {
+    write_vector(out, energies);
+    write_vector(out, num_groups);
+    write_value(out, static_cast<uint8_t>(summary != nullptr));
+    if (summary){
+        summary->save_state(out);
+    }
+}
+
+// fails if the checkpoint was written by a run that kept a summary and this one does
+// not, or the other way round
+bool sample_store::load_state(std::istream &in) {
+    uint8_t has_summary;
+    if (!read_vector(in, energies) || !read_vector(in, num_groups) || !read_value(in, has_summary)
+        || has_summary != (summary != nullptr)){
+        return false;
+    }
+    return !summary || summary->load_state(in);
+}
+
+void chain::run() {
+    run_steps(num_itrs);
+}
+
+// Runs the chain from itr up to end, or until a stop is requested. Runs can be split
+// into consecutive pieces without changing which states are kept.
+void chain::run_steps(long end) {
+    auto start = std::chrono::steady_clock::now();
+    if (stats_itr < 0){
+        stats_itr = itr;
+        stats_start = start;
+        model->stats.clear();
+    }
+    for(; itr < end && !stop_requested(); ++itr){
+        model->get_groups();
+        if(samples && (itr>burn_in) && (itr%thinning==0)){
+            samples->add(*model, itr);
+        }
+        if(report_progress && itr%progress_interval==0){
+            print_progress(itr);
+        }
+        if(stats_out && (itr+1)%stats_interval==0){
+            write_stats(itr+1);
+        }
+    }
+    seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void chain::save_state(std::ostream &out) {
+    write_value(out, static_cast<int64_t>(itr));
+    model->save_state(out);
+    own_samples.save_state(out);
+}
+
+bool chain::load_state(std::istream &in) {
+    int64_t next;
+    if (!read_value(in, next) || !model->load_state(in) || !own_samples.load_state(in)){
+        return false;
+    }
+    itr = next;
+    return true;
+}
+
+void chain::print_progress(long itr) {
+    std::lock_guard<std::mutex> guard(output_lock);
+    std::cout<<"-----------------------------------------------------"<<std::endl;
+    auto curr = std::chrono::system_clock::now();
+    auto tm = std::chrono::system_clock::to_time_t(curr);
+    std::cout<<"time: "<< std::put_time(std::localtime(&tm), "%c %Z")<<std::endl;
+    std::cout<<"chain: "<<id<<" iteration: "<<itr<<" energy: "<<model->loglike;
+    if (model->beta != 1.0){
+        std::cout<<" beta: "<<model->beta;
+    }
+    std::cout<<std::endl;
+    model->print_hcg_pairs();
+    std::cout<<std::endl;
+    model->print_hcg_edges();
+    std::cout<<std::endl;
+    model->print_group_size();
+    std::cout<<std::endl;
+}
+
+// A line holds the counts since the previous one: the moves proposed and accepted by
+// kind, the steps per second, and with HCP_TIMERS the time spent in each phase of a move
+void chain::write_stats(long itr) {
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - stats_start).count();
+    long steps = itr - stats_itr;
+    const sampler_stats &stats = model->stats;
+
+    std::ostringstream line;
+    line<<std::setprecision(10);
+    if (ensemble >= 0){
+        line<<"{\"chain\":"<<ensemble<<",\"replica\":"<<id;
+    }else{
+        line<<"{\"chain\":"<<id;
+    }
+    line<<",\"itr\":"<<itr<<",\"steps\":"<<steps<<",\"seconds\":"<<elapsed
+        <<",\"steps_per_second\":"<<((elapsed > 0.0) ? steps/elapsed : 0.0)
+        <<",\"beta\":"<<model->beta<<",\"loglike\":"<<model->loglike<<",\"groups\":"<<model->num_groups;
+    line<<",\"moves\":{";
+    for (int k = 0; k < NUM_MOVE_KINDS; ++k){
+        long long proposed = stats.proposed[k];
+        line<<((k > 0) ? "," : "")<<"\""<<move_kind_name(static_cast<move_kind>(k))<<"\":{\"proposed\":"<<proposed
+            <<",\"accepted\":"<<stats.accepted[k]
+            <<",\"rate\":"<<((proposed > 0) ? static_cast<double>(stats.accepted[k])/proposed : 0.0)<<"}";
+    }
+    line<<"}";
+    if (timers_enabled()){
+        line<<",\"time_unit\":\""<<timer_unit()<<"\",\"time\":{";
+        for (int p = 0; p < NUM_MOVE_PHASES; ++p){
+            line<<((p > 0) ? "," : "")<<"\""<<move_phase_name(static_cast<move_phase>(p))<<"\":"<<stats.cycles[p];
+        }
+        line<<"}";
+    }
+    line<<"}";
+    stats_out->write(line.str());
+
+    model->stats.clear();
+    stats_itr = itr;
+    stats_start = now;
+}
+
+stats_log::stats_log(const std::filesystem::path &path, bool append)
+    : _out(path, append ? std::ios::app : std::ios::trunc) {}
+
+void stats_log::write(const std::string &line) {
+    std::lock_guard<std::mutex> guard(_lock);
+    _out<<line<<'\n';
+    _out.flush();
+}
+
+double potential_scale_reduction(const std::vector<std::vector<double>> &traces) {
+    std::size_t m = traces.size();
+    if (m < 2){
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    // use the same number of samples from every chain
+    std::size_t n = traces[0].size();
+    for (const auto &trace : traces){
+        n = std::min(n, trace.size());
+    }
+    if (n < 2){
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+
+    std::vector<double> means(m, 0.0);
+    double grand_mean = 0.0;
+    double within = 0.0;
+    for (std::size_t c = 0; c < m; ++c){
+        for (std::size_t i = 0; i < n; ++i){
+            means[c] += traces[c][i];
+        }
+        means[c] /= n;
+        grand_mean += means[c]/m;
+
+        double var = 0.0;
+        for (std::size_t i = 0; i < n; ++i){
+            var += (traces[c][i] - means[c])*(traces[c][i] - means[c]);
+        }
+        within += var/(n-1)/m;
+    }
+    double between = 0.0;
+    for (std::size_t c = 0; c < m; ++c){
+        between += (means[c] - grand_mean)*(means[c] - grand_mean);
+    }
+    between *= static_cast<double>(n)/(m-1);
+
+    if (within == 0.0){
+        return (between == 0.0) ? 1.0 : std::numeric_limits<double>::infinity();
+    }
+    double pooled = (n-1.0)/n*within + between/n;
+    return std::sqrt(pooled/within);
+}
+
+double effective_sample_size(const std::vector<double> &trace) {
+    std::size_t n = trace.size();
+    if (n < 4){
+        return static_cast<double>(n);
+    }
+    double mean = 0.0;
+    for (double x : trace){
+        mean += x;
+    }
+    mean /= n;
+    double var = 0.0;
+    for (double x : trace){
+        var += (x - mean)*(x - mean);
+    }
+    var /= n;
+    if (var == 0.0){
+        return static_cast<double>(n);
+    }
+
+    auto autocorr = [&](std::size_t lag){
+        double c = 0.0;
+        for (std::size_t i = 0; i + lag < n; ++i){
+            c += (trace[i] - mean)*(trace[i+lag] - mean);
+        }
+        return c/(n*var);
+    };
+
+    // sum autocorrelation pairs while they stay positive
+    double tau = -1.0;
+    for (std::size_t lag = 0; lag + 1 < n; lag += 2){
+        double pair = autocorr(lag) + autocorr(lag+1);
+        if (pair <= 0.0){
+            break;
+        }
+        tau += 2.0*pair;
+    }
+    return n/std::max(tau, 1.0/n);
+}
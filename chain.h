@@ -0,0 +1,96 @@
+//
+// A single Markov chain of the hierarchical model together with the samples it keeps.
+//
+
+#ifndef HCP_CHAIN_H
+#define HCP_CHAIN_H
+
+#include "hierarchical_model.h"
+#include "parameters.h"
+#include "posterior_summary.h"
+#include "sample_file.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Destination of the thinned states of a chain. Full states are streamed to the writer,
+// if there is one, and added to the summary, if there is one; only the log-likelihood
+// and number of groups are kept in memory for the diagnostics, growing by one entry per
+// kept state.
+class sample_store {
+    public:
+        sample_writer *writer = nullptr;
+        std::unique_ptr<posterior_summary> summary;
+        std::vector<double> energies;
+        std::vector<std::size_t> num_groups;
+
+        void add(hierarchical_model &model, long itr);
+        // the diagnostics traces and the summary; the states themselves are in the writer's file
+        void save_state(std::ostream &out);
+        bool load_state(std::istream &in);
+};
+
+// The file chains write their statistics to, one JSON object per line. Chains on
+// different threads share it, so whole lines are written under a lock.
+class stats_log {
+    private:
+        std::ofstream _out;
+        std::mutex _lock;
+
+    public:
+        // appends to the file when continuing a run, and truncates it otherwise
+        stats_log(const std::filesystem::path &path, bool append);
+        bool is_open() const { return _out.is_open(); }
+        void write(const std::string &line);
+};
+
+class chain {
+    public:
+        int id;
+        unsigned long seed; // of the model's random number generator and its start
+        long num_itrs;
+        long itr = 0; // next iteration to run
+        long burn_in = 10000000; // iterations discarded before samples are kept
+        long thinning = 1500; // iterations between kept samples
+        long progress_interval = 10000000; // iterations between progress reports
+        bool report_progress; // only the first chain reports by default, to keep the output readable
+        std::unique_ptr<hierarchical_model> model;
+
+        sample_store own_samples;
+        sample_store *samples; // where kept states go, nullptr to keep none
+        double seconds = 0.0; // wall time spent running
+
+        stats_log *stats_out = nullptr; // where statistics go, nullptr to write none
+        long stats_interval = 0; // iterations between lines of statistics
+        int ensemble = -1; // ensemble the chain is a replica of, -1 if it runs on its own
+        long stats_itr = -1; // iteration the statistics being gathered start at
+        std::chrono::steady_clock::time_point stats_start;
+
+        // the model starts from random or given groups; start() gives it the start
+        // init_strategy asks for, which a run resumed from a checkpoint skips
+        chain(int id, const parameters &params, const NETWORK &network, unsigned long seed);
+        void start(const parameters &params);
+
+        void run();
+        void run_steps(long end);
+        void print_progress(long itr);
+        // writes the model's statistics since the last line and starts gathering anew
+        void write_stats(long itr);
+
+        void save_state(std::ostream &out);
+        bool load_state(std::istream &in);
+};
+
+// Gelman-Rubin potential scale reduction factor of one quantity traced by several chains.
+// Values close to 1 mean the chains agree. Returns NaN with fewer than two chains or samples.
+double potential_scale_reduction(const std::vector<std::vector<double>> &traces);
+
+// Effective number of independent samples in a trace, from its autocorrelations summed
+// up to the first negative pair (Geyer's initial positive sequence).
+double effective_sample_size(const std::vector<double> &trace);
+
+#endif //HCP_CHAIN_H
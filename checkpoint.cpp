@@ -0,0 +1,130 @@
+//
+// Checkpoints of a whole run, so a preempted or crashed run can resume where it stopped.
+//
+
+#include "checkpoint.h"
+#include "chain.h"
+#include "replica_exchange.h"
+#include "sample_file.h"
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+
+namespace {
+    const char CHECKPOINT_MAGIC[8] = {'H','C','P','C','K','P','T','1'};
+    const uint32_t CHECKPOINT_VERSION = 2;
+
+    // set from the signal handler and read by every chain once per iteration
+    std::atomic<bool> stop_flag(false);
+
+    void request_stop(int) {
+        stop_flag.store(true, std::memory_order_relaxed);
+    }
+}
+
+void write_rng(std::ostream &out, const gsl_rng *rng) {
+    std::size_t size = gsl_rng_size(rng);
+    write_value(out, static_cast<uint64_t>(size));
+    out.write(static_cast<const char*>(gsl_rng_state(rng)), size);
+}
+
+uint64_t bytes_left(std::istream &in) {
+    std::streampos here = in.tellg();
+    if (here == std::streampos(-1) || !in.seekg(0, std::ios::end)){
+        in.clear();
+        return UINT64_MAX;
+    }
+    std::streampos end = in.tellg();
+    in.seekg(here);
+    return (end > here) ? static_cast<uint64_t>(end - here) : 0;
+}
+
+bool read_rng(std::istream &in, gsl_rng *rng) {
+    uint64_t size;
+    if (!read_value(in, size) || size != gsl_rng_size(rng)){
+        return false;
+    }
+    return static_cast<bool>(in.read(static_cast<char*>(gsl_rng_state(rng)), size));
+}
+
+void install_stop_handlers() {
+    std::signal(SIGINT, request_stop);
+    std::signal(SIGTERM, request_stop);
+}
+
+bool stop_requested() {
+    return stop_flag.load(std::memory_order_relaxed);
+}
+
+bool write_checkpoint(const std::filesystem::path &path, std::vector<std::unique_ptr<chain>> &chains,
+                      std::vector<std::unique_ptr<replica_exchange>> &ensembles,
+                      std::vector<std::unique_ptr<sample_writer>> &writers) {
+    std::filesystem::path tmp_path = path;
+    tmp_path += ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary);
+    if (!out){
+        std::cerr<<"Unable to open '"<<tmp_path.string()<<"' for writing a checkpoint"<<std::endl;
+        return false;
+    }
+    int n_chains = writers.size();
+    int n_rungs = ensembles.empty() ? 1 : ensembles[0]->replicas.size();
+    std::size_t num_nodes = ensembles.empty() ? chains[0]->model->G.nvertices
+                                              : ensembles[0]->replicas[0]->model->G.nvertices;
+    out.write(CHECKPOINT_MAGIC, 8);
+    write_value(out, CHECKPOINT_VERSION);
+    write_value(out, static_cast<int32_t>(n_chains));
+    write_value(out, static_cast<int32_t>(n_rungs));
+    write_value(out, static_cast<uint64_t>(num_nodes));
+    for (int c = 0; c < n_chains; ++c){
+        write_value(out, writers[c] ? writers[c]->flush() : uint64_t(0));
+        if (ensembles.empty()){
+            chains[c]->save_state(out);
+        }else{
+            ensembles[c]->save_state(out);
+        }
+    }
+    out.close();
+    if (!out){
+        std::cerr<<"Unable to write checkpoint '"<<tmp_path.string()<<"'"<<std::endl;
+        return false;
+    }
+    std::filesystem::rename(tmp_path, path);
+    return true;
+}
+
+bool read_checkpoint(const std::filesystem::path &path, std::vector<std::unique_ptr<chain>> &chains,
+                     std::vector<std::unique_ptr<replica_exchange>> &ensembles,
+                     std::size_t num_nodes, std::vector<uint64_t> &sample_offsets) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in){
+        std::cerr<<"Unable to open checkpoint '"<<path.string()<<"'"<<std::endl;
+        return false;
+    }
+    char magic[8];
+    uint32_t version;
+    int32_t n_chains, n_rungs;
+    uint64_t nodes;
+    if (!in.read(magic, 8) || std::memcmp(magic, CHECKPOINT_MAGIC, 8) != 0
+        || !read_value(in, version) || version != CHECKPOINT_VERSION){
+        std::cerr<<"'"<<path.string()<<"' is not a checkpoint"<<std::endl;
+        return false;
+    }
+    int expected_chains = ensembles.empty() ? chains.size() : ensembles.size();
+    int expected_rungs = ensembles.empty() ? 1 : ensembles[0]->replicas.size();
+    if (!read_value(in, n_chains) || !read_value(in, n_rungs) || !read_value(in, nodes)
+        || n_chains != expected_chains || n_rungs != expected_rungs || nodes != num_nodes){
+        std::cerr<<"Checkpoint '"<<path.string()<<"' does not match the number of chains, temperatures or nodes"<<std::endl;
+        return false;
+    }
+    sample_offsets.assign(n_chains, 0);
+    for (int c = 0; c < n_chains; ++c){
+        bool loaded = read_value(in, sample_offsets[c])
+                      && (ensembles.empty() ? chains[c]->load_state(in) : ensembles[c]->load_state(in));
+        if (!loaded){
+            std::cerr<<"Checkpoint '"<<path.string()<<"' is truncated or corrupt, or posterior_summary has changed"<<std::endl;
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,78 @@
+//
+// Checkpoints of a whole run, so a preempted or crashed run can resume where it stopped.
+//
+// A checkpoint holds, for every chain, its next iteration, the full sampler state
+// (group states, slot table, node lists, counters, likelihood and random number
+// generator), the traces kept for the diagnostics, the posterior summary and how far its
+// sample file had been written. Resuming from it continues every chain exactly as if it had never stopped.
+//
+// Layout: char magic[8] = "HCPCKPT1", uint32 version, int32 chains, int32 temperatures,
+// uint64 nodes, then per chain the sample file offset and the chain or ensemble state.
+//
+
+#ifndef HCP_CHECKPOINT_H
+#define HCP_CHECKPOINT_H
+
+#include <cstdint>
+#include <filesystem>
+#include <gsl/gsl_rng.h>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+class chain;
+class replica_exchange;
+class sample_writer;
+
+template <typename T>
+void write_value(std::ostream &out, const T &value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool read_value(std::istream &in, T &value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+template <typename T>
+void write_vector(std::ostream &out, const std::vector<T> &values) {
+    write_value(out, static_cast<uint64_t>(values.size()));
+    out.write(reinterpret_cast<const char*>(values.data()), values.size()*sizeof(T));
+}
+
+// bytes from the read position to the end of the stream, or UINT64_MAX if it cannot seek
+uint64_t bytes_left(std::istream &in);
+
+// Fails without allocating when the stored length is more than the rest of the stream
+// holds, so a corrupt length cannot ask for an arbitrarily large vector.
+template <typename T>
+bool read_vector(std::istream &in, std::vector<T> &values) {
+    uint64_t size;
+    if (!read_value(in, size) || size > bytes_left(in)/sizeof(T)){
+        return false;
+    }
+    values.resize(size);
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(values.data()), size*sizeof(T)));
+}
+
+// the generator's internal state, so it continues the same stream after a restart
+void write_rng(std::ostream &out, const gsl_rng *rng);
+bool read_rng(std::istream &in, gsl_rng *rng);
+
+// SIGINT and SIGTERM ask the run to stop at the next iteration and write a checkpoint
+void install_stop_handlers();
+bool stop_requested();
+
+// Writes the checkpoint to a temporary file and renames it over path, so a crash while
+// writing leaves the previous checkpoint intact. Flushes the sample writers first; a
+// chain without one records an offset of 0.
+bool write_checkpoint(const std::filesystem::path &path, std::vector<std::unique_ptr<chain>> &chains,
+                      std::vector<std::unique_ptr<replica_exchange>> &ensembles,
+                      std::vector<std::unique_ptr<sample_writer>> &writers);
+// Restores the chains or ensembles, which must have been built from the same parameters
+// and network, and returns the offset each sample file is to be cut back to.
+bool read_checkpoint(const std::filesystem::path &path, std::vector<std::unique_ptr<chain>> &chains,
+                     std::vector<std::unique_ptr<replica_exchange>> &ensembles,
+                     std::size_t num_nodes, std::vector<uint64_t> &sample_offsets);
+
+#endif //HCP_CHECKPOINT_H
@@ -0,0 +1,25 @@
+//
+// Converts a binary sample file written by hcp into the text files written by earlier
+// versions (*_configs.txt, *_num_groups.txt, *_group_size.txt, *_edges.txt, *_pairs.txt
+// and *_ll.txt).
+//
+// usage: hcp_convert_samples <samples.bin> <save_directory> <saved_data_name>
+//
+
+#include "sample_file.h"
+#include <iostream>
+
+int main(int argc, char* argv[]) {
+    if (argc != 4){
+        std::cerr<<"usage: "<<argv[0]<<" <samples.bin> <save_directory> <saved_data_name>"<<std::endl;
+        return EXIT_FAILURE;
+    }
+    std::filesystem::path save_dir(argv[2]);
+    if (!std::filesystem::exists(save_dir)){
+        std::filesystem::create_directories(save_dir);
+    }
+    if (!convert_samples_to_text(argv[1], save_dir, argv[3])){
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
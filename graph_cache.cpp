@@ -0,0 +1,199 @@
+//
+// Binary cache of a parsed network, mapped straight into a NETWORK without copying.
+//
+
+#include "graph_cache.h"
+#include <algorithm>
+#include <cstdio>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    const char CACHE_MAGIC[8] = {'H','C','P','G','R','P','H','1'};
+    // version 3 caches hold simple graphs with sorted neighbours, and version 4 ones
+    // also record how the graph file was read
+    const uint32_t CACHE_VERSION = 4;
+    const uint32_t HEADER_BYTES = 128;
+    const uint64_t ALIGNMENT = 64;
+    const int NUM_SECTIONS = 6;
+
+    struct cache_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t header_bytes;
+        uint64_t nvertices;
+        uint64_t nentries;
+        uint32_t directed;
+        uint32_t weighted;
+        uint64_t source_size;
+        int64_t source_mtime;
+        uint64_t label_bytes;
+        uint64_t section[NUM_SECTIONS]; // offset, target, weight, id, label_offset, label_data
+        uint32_t source_format;
+        uint32_t remap_ids;
+    };
+    static_assert(sizeof(cache_header) <= HEADER_BYTES, "graph cache header too large");
+
+    uint64_t align(uint64_t pos) {
+        return (pos + ALIGNMENT - 1)/ALIGNMENT*ALIGNMENT;
+    }
+}
+
+bool stat_graph_source(const std::string &path, graph_format format, bool remap_ids, graph_source &source) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0){
+        return false;
+    }
+    source.size = info.st_size;
+    source.mtime = static_cast<int64_t>(info.st_mtim.tv_sec)*1000000000 + info.st_mtim.tv_nsec;
+    source.format = (format == graph_format::automatic) ? guess_graph_format(path) : format;
+    source.remap_ids = remap_ids || source.format != graph_format::edge_list;
+    return true;
+}
+
+std::string graph_cache_path(const std::string &graph_path) {
+    return graph_path + ".hcpg";
+}
+
+bool is_graph_cache(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[8];
+    return in.read(magic, 8) && std::memcmp(magic, CACHE_MAGIC, 8) == 0;
+}
+
+bool write_graph_cache(const NETWORK &network, const std::string &path, const graph_source &source) {
+    uint64_t n = network.nvertices;
+    uint64_t nentries = network.offset[n];
+    uint64_t label_bytes = 0;
+    for (uint64_t u = 0; u < n; ++u){
+        if (network.label_offset[u] >= 0){
+            label_bytes = std::max<uint64_t>(label_bytes, network.label_offset[u] + std::strlen(label(network, u)) + 1);
+        }
+    }
+
+    cache_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CACHE_MAGIC, 8);
+    header.version = CACHE_VERSION;
+    header.header_bytes = HEADER_BYTES;
+    header.nvertices = n;
+    header.nentries = nentries;
+    header.directed = network.directed;
+    header.weighted = (network.weight != NULL);
+    header.source_size = source.size;
+    header.source_mtime = source.mtime;
+    header.label_bytes = label_bytes;
+    header.source_format = static_cast<uint32_t>(source.format);
+    header.remap_ids = source.remap_ids;
+
+    const void *data[NUM_SECTIONS] = {network.offset, network.target, network.weight, network.id,
+                                      network.label_offset, network.label_data};
+    uint64_t bytes[NUM_SECTIONS] = {(n+1)*sizeof(int64_t), nentries*sizeof(int32_t),
+                                    header.weighted ? nentries*sizeof(double) : 0, n*sizeof(int64_t),
+                                    n*sizeof(int64_t), label_bytes};
+    uint64_t pos = HEADER_BYTES;
+    for (int s = 0; s < NUM_SECTIONS; ++s){
+        header.section[s] = pos;
+        pos = align(pos + bytes[s]);
+    }
+
+    // written under a temporary name and renamed, so a run never maps a half-written cache
+    std::string tmp_path = path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary);
+    if (!out){
+        std::cerr<<"Unable to open '"<<tmp_path<<"' for writing the graph cache"<<std::endl;
+        return false;
+    }
+    std::vector<char> padding(HEADER_BYTES, 0);
+    std::memcpy(padding.data(), &header, sizeof(header));
+    out.write(padding.data(), HEADER_BYTES);
+    pos = HEADER_BYTES;
+    for (int s = 0; s < NUM_SECTIONS; ++s){
+        std::vector<char> gap(header.section[s] - pos, 0);
+        out.write(gap.data(), gap.size());
+        if (bytes[s] > 0){
+            out.write(static_cast<const char*>(data[s]), bytes[s]);
+        }
+        pos = header.section[s] + bytes[s];
+    }
+    out.close();
+    if (!out){
+        std::cerr<<"Unable to write the graph cache '"<<tmp_path<<"'"<<std::endl;
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+bool map_graph_cache(NETWORK *network, const std::string &path, const graph_source *source) {
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || static_cast<uint64_t>(info.st_size) < HEADER_BYTES){
+        if (fd >= 0){
+            close(fd);
+        }
+        return false;
+    }
+    std::size_t size = info.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED){
+        return false;
+    }
+
+    cache_header header;
+    std::memcpy(&header, map, sizeof(header));
+    bool valid = std::memcmp(header.magic, CACHE_MAGIC, 8) == 0 && header.version == CACHE_VERSION
+                 && header.header_bytes == HEADER_BYTES;
+    if (valid && source){
+        valid = header.source_size == source->size && header.source_mtime == source->mtime
+                && header.source_format == static_cast<uint32_t>(source->format)
+                && header.remap_ids == static_cast<uint32_t>(source->remap_ids);
+    }
+    if (valid){
+        uint64_t n = header.nvertices;
+        uint64_t bytes[NUM_SECTIONS] = {(n+1)*sizeof(int64_t), header.nentries*sizeof(int32_t),
+                                        header.weighted ? header.nentries*sizeof(double) : 0, n*sizeof(int64_t),
+                                        n*sizeof(int64_t), header.label_bytes};
+        for (int s = 0; s < NUM_SECTIONS; ++s){
+            valid = valid && header.section[s] % ALIGNMENT == 0 && header.section[s] + bytes[s] <= size;
+        }
+    }
+    if (!valid){
+        munmap(map, size);
+        return false;
+    }
+
+    char *base = static_cast<char*>(map);
+    network->nvertices = header.nvertices;
+    network->directed = header.directed;
+    network->offset = reinterpret_cast<int64_t*>(base + header.section[0]);
+    network->target = reinterpret_cast<int32_t*>(base + header.section[1]);
+    network->weight = header.weighted ? reinterpret_cast<double*>(base + header.section[2]) : NULL;
+    network->id = reinterpret_cast<int64_t*>(base + header.section[3]);
+    network->label_offset = reinterpret_cast<int64_t*>(base + header.section[4]);
+    network->label_data = base + header.section[5];
+    network->mapping = map;
+    network->mapping_size = size;
+    return true;
+}
+
+bool map_sidecar_cache(NETWORK *network, const std::string &graph_path, graph_format format, bool remap_ids) {
+    auto start = std::chrono::steady_clock::now();
+    graph_source source;
+    std::string cache_path = graph_cache_path(graph_path);
+    if (!stat_graph_source(graph_path, format, remap_ids, source) || !map_graph_cache(network, cache_path, &source)){
+        return false;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout<<"mapped "<<network->nvertices<<" nodes and "<<network->offset[network->nvertices]
+             <<" adjacency entries from "<<cache_path<<" in "<<seconds<<" s"<<std::endl;
+    return true;
+}
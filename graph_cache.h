@@ -0,0 +1,49 @@
+//
+// Binary cache of a parsed network, mapped straight into a NETWORK without copying.
+//
+// Layout (native byte order, every section starting on a 64-byte boundary):
+//   header        char magic[8] = "HCPGRPH1", uint32 version, uint32 header bytes,
+//                 uint64 nvertices, uint64 adjacency entries, uint32 directed,
+//                 uint32 weighted, uint64 source size, int64 source mtime (ns),
+//                 uint64 label bytes, uint64 file offset of each section below,
+//                 uint32 source format, uint32 remap ids
+//   sections      int64 offset[nvertices+1], int32 target[entries],
+//                 double weight[entries] (only if weighted), int64 id[nvertices],
+//                 int64 label_offset[nvertices], char label_data[label bytes]
+// The size and modification time of the graph file it was made from are recorded, so a
+// cache next to a graph file is only used while the graph file is unchanged. So are the
+// format it was parsed as and whether node IDs were remapped, which decide the vertices
+// and their numbering, so a run reading the file differently parses it again.
+//
+
+#ifndef HCP_GRAPH_CACHE_H
+#define HCP_GRAPH_CACHE_H
+
+#include "graph_formats.h"
+#include "network.h"
+#include <cstdint>
+#include <string>
+
+// identifies the version of a graph file a cache was made from, and how it was read
+struct graph_source {
+    uint64_t size;
+    int64_t mtime;
+    graph_format format; // never automatic
+    bool remap_ids; // always true for formats other than edge lists, which cannot turn it off
+};
+
+// the source as a graph file would be read with format and remap_ids
+bool stat_graph_source(const std::string &path, graph_format format, bool remap_ids, graph_source &source);
+// the cache that belongs next to a graph file
+std::string graph_cache_path(const std::string &graph_path);
+bool is_graph_cache(const std::string &path);
+
+bool write_graph_cache(const NETWORK &network, const std::string &path, const graph_source &source);
+// Maps a cache file and points the network's arrays into it. Given a source, a cache
+// made from any other version of the graph file is rejected.
+bool map_graph_cache(NETWORK *network, const std::string &path, const graph_source *source);
+// Maps the cache next to graph_path if it was made from the current version of the
+// file, read with the same format and remap_ids
+bool map_sidecar_cache(NETWORK *network, const std::string &graph_path, graph_format format, bool remap_ids);
+
+#endif //HCP_GRAPH_CACHE_H
@@ -0,0 +1,688 @@
+//
+// Readers for the network file formats other than GML, and the choice between them.
+//
+
+#include "graph_formats.h"
+#include "graph_cache.h"
+#include "network_builder.h"
+#include "readgml.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef HCP_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HCP_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+    const std::size_t CHUNK_BYTES = 1<<20;
+
+    class file_stream : public input_stream {
+        private:
+            std::FILE *_file;
+        public:
+            explicit file_stream(std::FILE *file) : _file(file) {}
+            ~file_stream() override { std::fclose(_file); }
+            long read(char *buffer, std::size_t size) override {
+                std::size_t n = std::fread(buffer, 1, size, _file);
+                return (n == 0 && std::ferror(_file)) ? -1 : static_cast<long>(n);
+            }
+    };
+
+#ifdef HCP_HAVE_ZLIB
+    class gzip_stream : public input_stream {
+        private:
+            gzFile _file;
+        public:
+            explicit gzip_stream(gzFile file) : _file(file) {
+                gzbuffer(_file, CHUNK_BYTES);
+            }
+            ~gzip_stream() override { gzclose(_file); }
+            long read(char *buffer, std::size_t size) override {
+                return gzread(_file, buffer, static_cast<unsigned>(std::min<std::size_t>(size, INT_MAX)));
+            }
+    };
+#endif
+
+#ifdef HCP_HAVE_ZSTD
+    class zstd_stream : public input_stream {
+        private:
+            std::FILE *_file;
+            ZSTD_DStream *_stream;
+            std::vector<char> _compressed;
+            ZSTD_inBuffer _input;
+        public:
+            explicit zstd_stream(std::FILE *file)
+                : _file(file), _stream(ZSTD_createDStream()), _compressed(ZSTD_DStreamInSize()), _input{NULL, 0, 0} {
+                ZSTD_initDStream(_stream);
+            }
+            ~zstd_stream() override {
+                ZSTD_freeDStream(_stream);
+                std::fclose(_file);
+            }
+            long read(char *buffer, std::size_t size) override {
+                ZSTD_outBuffer output = {buffer, size, 0};
+                while (output.pos == 0){
+                    if (_input.pos == _input.size){
+                        std::size_t n = std::fread(_compressed.data(), 1, _compressed.size(), _file);
+                        if (n == 0){
+                            return std::ferror(_file) ? -1 : 0;
+                        }
+                        _input = {_compressed.data(), n, 0};
+                    }
+                    std::size_t status = ZSTD_decompressStream(_stream, &output, &_input);
+                    if (ZSTD_isError(status)){
+                        return -1;
+                    }
+                }
+                return output.pos;
+            }
+    };
+#endif
+
+    const char *skip_blanks(const char *pos, const char *end) {
+        while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r' || *pos == ',')){
+            pos++;
+        }
+        return pos;
+    }
+
+    // reads the next whitespace separated number of a line, returning false if there is none
+    template <typename T>
+    bool next_field(const char *&pos, const char *end, T &value) {
+        pos = skip_blanks(pos, end);
+        if (pos < end && *pos == '+'){
+            pos++;
+        }
+        auto result = std::from_chars(pos, end, value);
+        if (result.ec != std::errc()){
+            return false;
+        }
+        pos = result.ptr;
+        return true;
+    }
+
+    struct id_edge {
+        int64_t source;
+        int64_t target;
+        double weight;
+    };
+
+    void report_read(const NETWORK *network, std::size_t nedges, int64_t dropped, long long bytes,
+                     std::chrono::steady_clock::time_point start) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout<<"read "<<network->nvertices<<" nodes and "<<nedges - dropped<<" edges in "<<seconds<<" s ("
+                 <<bytes/1e6/seconds<<" MB/s)";
+        if (dropped > 0){
+            std::cout<<", dropping "<<dropped<<" self-loops and repeated edges";
+        }
+        std::cout<<std::endl;
+    }
+
+    [[noreturn]] void read_failed(const std::string &path, const std::string &reason) {
+        std::cerr<<"Unable to read '"<<path<<"': "<<reason<<std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::string strip_compression(const std::string &path) {
+        for (const char *suffix : {".gz", ".zst"}){
+            std::size_t length = std::strlen(suffix);
+            if (path.size() > length && path.compare(path.size() - length, length, suffix) == 0){
+                return path.substr(0, path.size() - length);
+            }
+        }
+        return path;
+    }
+
+    bool ends_with(const std::string &text, const std::string &suffix) {
+        return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+}
+
+namespace {
+    bool is_gzip(const unsigned char *magic, std::size_t size) {
+        return size >= 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+    }
+
+    bool is_zstd(const unsigned char *magic, std::size_t size) {
+        return size >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd;
+    }
+}
+
+bool is_compressed(const char *data, std::size_t size) {
+    const unsigned char *magic = reinterpret_cast<const unsigned char*>(data);
+    return is_gzip(magic, size) || is_zstd(magic, size);
+}
+
+std::unique_ptr<input_stream> open_input_stream(const std::string &path) {
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+    if (file == NULL){
+        return nullptr;
+    }
+    unsigned char magic[4] = {0, 0, 0, 0};
+    std::size_t n = std::fread(magic, 1, 4, file);
+    std::rewind(file);
+    bool gzip = is_gzip(magic, n);
+    bool zstd = is_zstd(magic, n);
+    if (gzip){
+#ifdef HCP_HAVE_ZLIB
+        std::fclose(file);
+        gzFile gz = gzopen(path.c_str(), "rb");
+        return gz ? std::make_unique<gzip_stream>(gz) : nullptr;
+#else
+        std::fclose(file);
+        read_failed(path, "gzip input needs hcp to be built with zlib");
+#endif
+    }
+    if (zstd){
+#ifdef HCP_HAVE_ZSTD
+        return std::make_unique<zstd_stream>(file);
+#else
+        std::fclose(file);
+        read_failed(path, "zstd input needs hcp to be built with libzstd");
+#endif
+    }
+    return std::make_unique<file_stream>(file);
+}
+
+namespace {
+    // A block of whole lines, pointing into the mapped file or into text
+    struct line_block {
+        const char *begin = NULL;
+        const char *end = NULL;
+        std::vector<char> text;
+    };
+
+    // Hands out a file as blocks of whole lines. An uncompressed file is mapped and cut
+    // into blocks in place; a compressed one is decompressed a block at a time.
+    class line_reader {
+        private:
+            std::string _path;
+            char *_map;
+            std::size_t _size;
+            std::size_t _pos;
+            std::unique_ptr<input_stream> _stream;
+            std::vector<char> _carry; // the unfinished line at the end of the last block
+            std::size_t _block_bytes;
+            long long _bytes;
+            bool _done;
+
+        public:
+            line_reader(const std::string &path, int num_threads)
+                : _path(path), _map(NULL), _size(0), _pos(0), _block_bytes(4*CHUNK_BYTES), _bytes(0), _done(false) {
+                int fd = open(path.c_str(), O_RDONLY);
+                struct stat info;
+                if (fd < 0 || fstat(fd, &info) != 0){
+                    read_failed(path, std::strerror(errno));
+                }
+                _size = info.st_size;
+                if (_size > 0){
+                    void *map = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (map == MAP_FAILED){
+                        read_failed(path, std::strerror(errno));
+                    }
+                    _map = static_cast<char*>(map);
+                }
+                close(fd);
+                if (is_compressed(_map, _size)){
+                    munmap(_map, _size);
+                    _map = NULL;
+                    _stream = open_input_stream(path);
+                    if (!_stream){
+                        read_failed(path, std::strerror(errno));
+                    }
+                }else{
+                    // a few blocks per thread, so that uneven blocks still keep them all busy
+                    _block_bytes = std::max(CHUNK_BYTES, _size/(4*num_threads) + 1);
+                    madvise(_map, _size, MADV_SEQUENTIAL);
+                }
+            }
+
+            ~line_reader() {
+                if (_map != NULL){
+                    munmap(_map, _size);
+                }
+            }
+
+            line_reader(const line_reader&) = delete;
+            line_reader& operator=(const line_reader&) = delete;
+
+            // the bytes of file content handed out so far
+            long long bytes() const {
+                return _bytes;
+            }
+
+            // fills in the next block, returning false at the end of the file
+            bool next(line_block &block) {
+                if (!_stream){
+                    if (_pos >= _size){
+                        return false;
+                    }
+                    std::size_t stop = std::min(_size, _pos + _block_bytes);
+                    const void *newline = std::memchr(_map + stop - 1, '\n', _size - stop + 1);
+                    stop = newline ? static_cast<const char*>(newline) - _map + 1 : _size;
+                    block.begin = _map + _pos;
+                    block.end = _map + stop;
+                    _bytes += stop - _pos;
+                    _pos = stop;
+                    return true;
+                }
+
+                std::vector<char> &text = block.text;
+                text.swap(_carry);
+                _carry.clear();
+                std::size_t filled = text.size();
+                while (!_done){
+                    text.resize(filled + _block_bytes);
+                    while (filled < text.size()){
+                        long n = _stream->read(text.data() + filled, text.size() - filled);
+                        if (n < 0){
+                            read_failed(_path, "the file could not be decompressed");
+                        }
+                        if (n == 0){
+                            _done = true;
+                            break;
+                        }
+                        filled += n;
+                        _bytes += n;
+                    }
+                    text.resize(filled);
+                    auto newline = std::find(text.rbegin(), text.rend(), '\n');
+                    if (_done || newline != text.rend()){
+                        if (!_done){
+                            _carry.assign(newline.base(), text.end());
+                            text.erase(newline.base(), text.end());
+                        }
+                        break;
+                    }
+                    // a line longer than a block, read on
+                }
+                if (text.empty()){
+                    return false;
+                }
+                block.begin = text.data();
+                block.end = text.data() + text.size();
+                return true;
+            }
+    };
+
+    // calls line(begin, end) for every line between begin and end, without the newline
+    template <typename F>
+    void for_each_line(const char *begin, const char *end, F &&line) {
+        while (begin < end){
+            const char *newline = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+            const char *stop = newline ? newline : end;
+            line(begin, stop);
+            begin = stop + 1;
+        }
+    }
+
+    // Parses the blocks of reader on the threads of pool, parse(begin, end, result)
+    // filling in one result per block. The next blocks are read while the previous
+    // ones are parsed, and the results come back in file order.
+    template <typename R, typename F>
+    std::deque<R> parse_blocks(line_reader &reader, thread_pool &pool, F parse) {
+        std::deque<R> results;
+        std::vector<line_block> current(pool.size()), upcoming(pool.size());
+        auto fill = [&reader](std::vector<line_block> &blocks) {
+            std::size_t count = 0;
+            while (count < blocks.size() && reader.next(blocks[count])){
+                count++;
+            }
+            return count;
+        };
+        std::size_t count = fill(current);
+        while (count > 0){
+            for (std::size_t b = 0; b < count; ++b){
+                results.emplace_back();
+                R &result = results.back();
+                const line_block &block = current[b];
+                pool.submit([&parse, &result, &block]() { parse(block.begin, block.end, result); });
+            }
+            std::size_t upcoming_count = fill(upcoming);
+            pool.wait();
+            std::swap(current, upcoming);
+            count = upcoming_count;
+        }
+        return results;
+    }
+
+    // the line number of a bad line within the file, or 0 if no block has one
+    template <typename R>
+    long long first_bad_line(const std::deque<R> &blocks, long long lines_before) {
+        for (const R &block : blocks){
+            if (block.bad_line != 0){
+                return lines_before + block.bad_line;
+            }
+            lines_before += block.lines;
+        }
+        return 0;
+    }
+
+    // joins the sorted lists into one, dropping repeats, by merging pairs in parallel
+    std::vector<int64_t> merge_sorted(std::vector<std::vector<int64_t>> lists, thread_pool &pool) {
+        while (lists.size() > 1){
+            std::vector<std::vector<int64_t>> merged((lists.size() + 1)/2);
+            for (std::size_t i = 0; i < merged.size(); ++i){
+                pool.submit([&lists, &merged, i]() {
+                    if (2*i + 1 == lists.size()){
+                        merged[i].swap(lists[2*i]);
+                        return;
+                    }
+                    const std::vector<int64_t> &a = lists[2*i];
+                    const std::vector<int64_t> &b = lists[2*i + 1];
+                    merged[i].resize(a.size() + b.size());
+                    auto last = std::set_union(a.begin(), a.end(), b.begin(), b.end(), merged[i].begin());
+                    merged[i].erase(last, merged[i].end());
+                    std::vector<int64_t>().swap(lists[2*i]);
+                    std::vector<int64_t>().swap(lists[2*i + 1]);
+                });
+            }
+            pool.wait();
+            lists.swap(merged);
+        }
+        return lists.empty() ? std::vector<int64_t>() : std::move(lists[0]);
+    }
+
+    struct edge_block {
+        std::vector<id_edge> edges;
+        long long lines = 0;
+        long long bad_line = 0; // first line that is not an edge, counted from the block start
+        int64_t min_id = INT64_MAX;
+        int64_t max_id = INT64_MIN;
+    };
+
+    struct entry_block {
+        std::vector<index_edge> edges;
+        long long lines = 0;
+        long long bad_line = 0;
+    };
+}
+
+graph_format guess_graph_format(const std::string &path) {
+    std::string name = strip_compression(path);
+    if (ends_with(name, ".gml")){
+        return graph_format::gml;
+    }
+    if (ends_with(name, ".mtx")){
+        return graph_format::matrix_market;
+    }
+    return graph_format::edge_list;
+}
+
+int read_edge_list(NETWORK *network, const std::string &path, bool remap_ids, int num_threads) {
+    auto start = std::chrono::steady_clock::now();
+    thread_pool pool(num_threads);
+    line_reader reader(path, num_threads);
+
+    std::deque<edge_block> blocks = parse_blocks<edge_block>(reader, pool,
+        [](const char *begin, const char *end, edge_block &block) {
+            block.edges.reserve((end - begin)/16);
+            for_each_line(begin, end, [&block](const char *pos, const char *stop) {
+                block.lines++;
+                pos = skip_blanks(pos, stop);
+                if (pos == stop || *pos == '#' || *pos == '%'){
+                    return;
+                }
+                id_edge edge;
+                edge.weight = 1.0;
+                if (!next_field(pos, stop, edge.source) || !next_field(pos, stop, edge.target)){
+                    if (block.bad_line == 0){
+                        block.bad_line = block.lines;
+                    }
+                    return;
+                }
+                next_field(pos, stop, edge.weight);
+                block.min_id = std::min({block.min_id, edge.source, edge.target});
+                block.max_id = std::max({block.max_id, edge.source, edge.target});
+                block.edges.push_back(edge);
+            });
+        });
+    long long bad_line = first_bad_line(blocks, 0);
+    if (bad_line != 0){
+        read_failed(path, "line " + std::to_string(bad_line) + " is not an edge");
+    }
+
+    // the vertices are the distinct IDs in increasing order, or 0..max ID without remapping
+    std::vector<int64_t> ids;
+    int64_t min_id = INT64_MAX;
+    int64_t max_id = INT64_MIN;
+    std::size_t nedges = 0;
+    for (const edge_block &block : blocks){
+        min_id = std::min(min_id, block.min_id);
+        max_id = std::max(max_id, block.max_id);
+        nedges += block.edges.size();
+    }
+    if (remap_ids && nedges > 0 && static_cast<uint64_t>(max_id) - static_cast<uint64_t>(min_id) < 32ULL*nedges){
+        // IDs within a modest range are marked in a table and read off it in order
+        uint64_t range = static_cast<uint64_t>(max_id) - static_cast<uint64_t>(min_id) + 1;
+        std::unique_ptr<std::atomic<uint8_t>[]> seen(new std::atomic<uint8_t>[range]());
+        for (std::size_t b = 0; b < blocks.size(); ++b){
+            pool.submit([&blocks, &seen, min_id, b]() {
+                for (const id_edge &e : blocks[b].edges){
+                    seen[e.source - min_id].store(1, std::memory_order_relaxed);
+                    seen[e.target - min_id].store(1, std::memory_order_relaxed);
+                }
+            });
+        }
+        pool.wait();
+        std::size_t parts = pool.size();
+        std::vector<std::size_t> first_id(parts + 1, 0);
+        for (std::size_t p = 0; p < parts; ++p){
+            pool.submit([&, p]() {
+                for (uint64_t i = range*p/parts; i < range*(p+1)/parts; ++i){
+                    first_id[p+1] += seen[i].load(std::memory_order_relaxed);
+                }
+            });
+        }
+        pool.wait();
+        for (std::size_t p = 0; p < parts; ++p){
+            first_id[p+1] += first_id[p];
+        }
+        ids.resize(first_id[parts]);
+        for (std::size_t p = 0; p < parts; ++p){
+            pool.submit([&, p]() {
+                std::size_t next = first_id[p];
+                for (uint64_t i = range*p/parts; i < range*(p+1)/parts; ++i){
+                    if (seen[i].load(std::memory_order_relaxed)){
+                        ids[next++] = min_id + i;
+                    }
+                }
+            });
+        }
+        pool.wait();
+    }else if (remap_ids){
+        // widely scattered IDs are sorted block by block and merged
+        std::vector<std::vector<int64_t>> block_ids(blocks.size());
+        for (std::size_t b = 0; b < blocks.size(); ++b){
+            pool.submit([&blocks, &block_ids, b]() {
+                std::vector<int64_t> &list = block_ids[b];
+                list.reserve(2*blocks[b].edges.size());
+                for (const id_edge &e : blocks[b].edges){
+                    list.push_back(e.source);
+                    list.push_back(e.target);
+                }
+                std::sort(list.begin(), list.end());
+                list.erase(std::unique(list.begin(), list.end()), list.end());
+            });
+        }
+        pool.wait();
+        ids = merge_sorted(std::move(block_ids), pool);
+    }else if (nedges > 0){
+        if (min_id < 0){
+            read_failed(path, "negative node ID without remap_node_ids");
+        }
+        if (max_id >= INT_MAX){
+            read_failed(path, "node IDs are too large to use as indices; set remap_node_ids: true");
+        }
+        ids.resize(max_id + 1);
+        for (int64_t u = 0; u <= max_id; ++u){
+            ids[u] = u;
+        }
+    }
+    if (ids.size() >= static_cast<std::size_t>(INT_MAX)){
+        read_failed(path, "too many nodes");
+    }
+
+    // resolve every block into its place in one edge array, freeing the block as it goes
+    id_index index(ids);
+    std::vector<std::size_t> first_edge(blocks.size() + 1, 0);
+    for (std::size_t b = 0; b < blocks.size(); ++b){
+        first_edge[b+1] = first_edge[b] + blocks[b].edges.size();
+    }
+    std::vector<index_edge> resolved(first_edge.back());
+    for (std::size_t b = 0; b < blocks.size(); ++b){
+        pool.submit([&, b]() {
+            index_edge *out = resolved.data() + first_edge[b];
+            for (const id_edge &e : blocks[b].edges){
+                *out++ = {index.find(e.source), index.find(e.target), e.weight};
+            }
+            std::vector<id_edge>().swap(blocks[b].edges);
+        });
+    }
+    pool.wait();
+    int64_t dropped = build_adjacency(network, ids.size(), 0, resolved, pool);
+    set_vertex_ids(network, ids);
+    report_read(network, resolved.size(), dropped, reader.bytes(), start);
+    return 0;
+}
+
+int read_matrix_market(NETWORK *network, const std::string &path, int num_threads) {
+    auto start = std::chrono::steady_clock::now();
+    thread_pool pool(num_threads);
+    line_reader reader(path, num_threads);
+
+    // the banner, comments and size line are read first, from the start of the file
+    line_block first;
+    long long header_lines = 0;
+    bool weighted = true;
+    int64_t rows = -1, cols = -1, entries = -1;
+    const char *rest = NULL;
+    while (rows < 0 && reader.next(first)){
+        const char *pos = first.begin;
+        while (rows < 0 && pos < first.end){
+            const char *newline = static_cast<const char*>(std::memchr(pos, '\n', first.end - pos));
+            const char *stop = newline ? newline : first.end;
+            header_lines++;
+            if (header_lines == 1){
+                std::string banner(pos, stop);
+                for (char &c : banner){
+                    c = std::tolower(static_cast<unsigned char>(c));
+                }
+                if (banner.rfind("%%matrixmarket", 0) != 0 || banner.find("coordinate") == std::string::npos){
+                    read_failed(path, "not a Matrix Market coordinate file");
+                }else if (banner.find("complex") != std::string::npos){
+                    read_failed(path, "complex matrices are not supported");
+                }
+                weighted = banner.find("pattern") == std::string::npos;
+            }else{
+                const char *field = skip_blanks(pos, stop);
+                if (field != stop && *field != '%'){
+                    if (!next_field(field, stop, rows) || !next_field(field, stop, cols)
+                        || !next_field(field, stop, entries) || std::max(rows, cols) >= INT_MAX){
+                        read_failed(path, "unreadable size line");
+                    }
+                }
+            }
+            pos = stop + 1;
+        }
+        rest = pos;
+    }
+    if (rows < 0){
+        read_failed(path, "missing size line");
+    }
+
+    auto parse = [weighted, rows, cols](const char *begin, const char *end, entry_block &block) {
+        for_each_line(begin, end, [&](const char *pos, const char *stop) {
+            block.lines++;
+            pos = skip_blanks(pos, stop);
+            if (pos == stop || *pos == '%' || block.bad_line != 0){
+                return;
+            }
+            int64_t i, j;
+            double value = 1.0;
+            if (!next_field(pos, stop, i) || !next_field(pos, stop, j) || (weighted && !next_field(pos, stop, value))
+                || i < 1 || j < 1 || i > rows || j > cols){
+                block.bad_line = block.lines;
+                return;
+            }
+            block.edges.push_back({static_cast<int32_t>(i-1), static_cast<int32_t>(j-1), value});
+        });
+    };
+    entry_block head;
+    parse(std::min(rest, first.end), first.end, head);
+    std::deque<entry_block> blocks = parse_blocks<entry_block>(reader, pool, parse);
+    blocks.push_front(std::move(head));
+    long long bad_line = first_bad_line(blocks, header_lines);
+    if (bad_line != 0){
+        read_failed(path, "line " + std::to_string(bad_line) + " is not a valid entry");
+    }
+
+    std::vector<std::size_t> first_edge(blocks.size() + 1, 0);
+    for (std::size_t b = 0; b < blocks.size(); ++b){
+        first_edge[b+1] = first_edge[b] + blocks[b].edges.size();
+    }
+    std::vector<index_edge> edges(first_edge.back());
+    for (std::size_t b = 0; b < blocks.size(); ++b){
+        pool.submit([&, b]() {
+            std::copy(blocks[b].edges.begin(), blocks[b].edges.end(), edges.begin() + first_edge[b]);
+            std::vector<index_edge>().swap(blocks[b].edges);
+        });
+    }
+    pool.wait();
+
+    // every row and column index is a vertex, numbered from 1 as in the file
+    int n = std::max(rows, cols);
+    std::vector<int64_t> ids(n);
+    for (int u = 0; u < n; ++u){
+        ids[u] = u + 1;
+    }
+    int64_t dropped = build_adjacency(network, n, 0, edges, pool);
+    set_vertex_ids(network, ids);
+    report_read(network, edges.size(), dropped, reader.bytes(), start);
+    return 0;
+}
+
+int parse_graph(NETWORK *network, const std::string &path, graph_format format, bool remap_ids, int num_threads) {
+    if (format == graph_format::automatic){
+        format = guess_graph_format(path);
+    }
+    switch (format){
+        case graph_format::edge_list:
+            return read_edge_list(network, path, remap_ids, num_threads);
+        case graph_format::matrix_market:
+            return read_matrix_market(network, path, num_threads);
+        default:
+            return read_gml(network, path, num_threads);
+    }
+}
+
+int read_graph(NETWORK *network, const std::string &path, graph_format format, bool remap_ids, int num_threads) {
+    if (format == graph_format::automatic){
+        format = guess_graph_format(path);
+    }
+    if (format == graph_format::gml || is_graph_cache(path)){
+        return read_network(network, path, num_threads);
+    }
+    if (map_sidecar_cache(network, path, format, remap_ids)){
+        return 0;
+    }
+    return parse_graph(network, path, format, remap_ids, num_threads);
+}
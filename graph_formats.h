@@ -0,0 +1,57 @@
+//
+// Readers for the network file formats other than GML, and the choice between them.
+//
+// Edge lists hold one edge per line as two integer node IDs and an optional weight,
+// separated by whitespace or commas; lines starting with '#' or '%' are comments.
+// Matrix Market files must be coordinate matrices, whose 1-based row and column
+// indices become the vertices. Both are read as undirected networks, and may be
+// compressed with gzip or zstd, which is recognised from the file contents. They are
+// read in blocks of whole lines that are parsed on num_threads threads: a plain file is
+// mapped and cut into blocks in place, while a compressed one is decompressed a block
+// at a time, so it is never held in memory as a whole.
+//
+
+#ifndef HCP_GRAPH_FORMATS_H
+#define HCP_GRAPH_FORMATS_H
+
+#include "network.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+
+enum class graph_format {
+    automatic,     // chosen from the file name
+    gml,
+    edge_list,
+    matrix_market
+};
+
+// a decompressing or plain byte stream over a file
+class input_stream {
+    public:
+        virtual ~input_stream() = default;
+        // reads up to size bytes, returning how many were read, 0 at the end of the
+        // stream, or -1 on an error
+        virtual long read(char *buffer, std::size_t size) = 0;
+};
+
+std::unique_ptr<input_stream> open_input_stream(const std::string &path);
+bool is_compressed(const char *data, std::size_t size);
+
+// the format of a file from its name, ignoring a .gz or .zst suffix: .gml is GML, .mtx
+// is Matrix Market and anything else an edge list
+graph_format guess_graph_format(const std::string &path);
+
+// With remap_ids, node IDs may be any integers and become vertices in increasing order
+// of ID. Without it, IDs must be 0..n-1 and are used as vertex indices directly, so
+// nodes without edges are kept.
+int read_edge_list(NETWORK *network, const std::string &path, bool remap_ids, int num_threads);
+int read_matrix_market(NETWORK *network, const std::string &path, int num_threads);
+
+// Reads a network in any supported format, mapping a binary cache instead when path
+// is one or an up-to-date cache sits next to it (see graph_cache.h).
+int read_graph(NETWORK *network, const std::string &path, graph_format format, bool remap_ids, int num_threads);
+// Same, but always parses the file itself
+int parse_graph(NETWORK *network, const std::string &path, graph_format format, bool remap_ids, int num_threads);
+
+#endif //HCP_GRAPH_FORMATS_H
@@ -0,0 +1,117 @@
+//
+// Group states hold one bit per group slot. Up to 64 slots they are unsigned integers;
+// wider states are wide_state<W>, W 64-bit words holding slot s in bit s%64 of word
+// s/64. The model only touches states through the operators and functions below, so
+// the same code runs on both.
+//
+
+#ifndef HCP_GROUP_STATE_H
+#define HCP_GROUP_STATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+template <int W>
+struct wide_state {
+    uint64_t word[W];
+
+    wide_state(uint64_t low = 0) : word{low} {}
+
+    static wide_state bit(int slot) {
+        wide_state state;
+        state.word[slot>>6] = 1ULL<<(slot&63);
+        return state;
+    }
+
+    wide_state& operator&=(const wide_state &other) {
+        for (int w = 0; w < W; ++w){
+            word[w] &= other.word[w];
+        }
+        return *this;
+    }
+    wide_state& operator|=(const wide_state &other) {
+        for (int w = 0; w < W; ++w){
+            word[w] |= other.word[w];
+        }
+        return *this;
+    }
+    wide_state& operator^=(const wide_state &other) {
+        for (int w = 0; w < W; ++w){
+            word[w] ^= other.word[w];
+        }
+        return *this;
+    }
+    wide_state operator~() const {
+        wide_state state;
+        for (int w = 0; w < W; ++w){
+            state.word[w] = ~word[w];
+        }
+        return state;
+    }
+    friend wide_state operator&(wide_state a, const wide_state &b) { return a &= b; }
+    friend wide_state operator|(wide_state a, const wide_state &b) { return a |= b; }
+    friend wide_state operator^(wide_state a, const wide_state &b) { return a ^= b; }
+    friend bool operator==(const wide_state &a, const wide_state &b) {
+        for (int w = 0; w < W; ++w){
+            if (a.word[w] != b.word[w]){
+                return false;
+            }
+        }
+        return true;
+    }
+    friend bool operator!=(const wide_state &a, const wide_state &b) { return !(a == b); }
+};
+
+template <typename state_t>
+inline state_t slot_bit(int slot) {
+    if constexpr (std::is_integral<state_t>::value){
+        return static_cast<state_t>(static_cast<state_t>(1)<<slot);
+    }else{
+        return state_t::bit(slot);
+    }
+}
+
+template <typename state_t>
+inline bool has_slot(const state_t &state, int slot) {
+    if constexpr (std::is_integral<state_t>::value){
+        return (state>>slot)&1U;
+    }else{
+        return (state.word[slot>>6]>>(slot&63))&1U;
+    }
+}
+
+// Highest slot two group states share. Every state holds slot 0, so there always is
+// one, and it is the highest set bit of their intersection. Wide states are searched
+// from their top word down.
+template <typename state_t>
+inline std::size_t highest_common_slot(const state_t &a, const state_t &b) {
+    if constexpr (std::is_integral<state_t>::value){
+        return 63 - __builtin_clzll(static_cast<uint64_t>(a & b));
+    }else{
+        constexpr int W = sizeof(state_t)/sizeof(uint64_t);
+        for (int w = W-1; w > 0; --w){
+            uint64_t common_bits = a.word[w] & b.word[w];
+            if (common_bits != 0){
+                return 64*w + 63 - __builtin_clzll(common_bits);
+            }
+        }
+        return 63 - __builtin_clzll(a.word[0] & b.word[0]);
+    }
+}
+
+// 64 bits standing for a state, for hashing
+template <typename state_t>
+inline uint64_t state_key(const state_t &state) {
+    if constexpr (std::is_integral<state_t>::value){
+        return state;
+    }else{
+        uint64_t key = state.word[0];
+        for (std::size_t w = 1; w < sizeof(state_t)/sizeof(uint64_t); ++w){
+            key = (key ^ state.word[w])*0xFF51AFD7ED558CCDULL;
+        }
+        return key;
+    }
+}
+
+#endif //HCP_GROUP_STATE_H
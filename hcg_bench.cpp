@@ -0,0 +1,170 @@
+//
+// Measures how fast the highest common group of node pairs is found for each width of
+// group state, from 8 bits to the 512-bit wide_state. Random states, all holding slot 0
+// like the model's, are given to the nodes, and the hcg of random pairs of nodes is
+// summed the way set_hcg_edges does it. Wide states have every word filled, so their
+// search stops in the top word; in the model it goes down a word for each empty word
+// above the highest common group. The 64-bit bit smear the model used before is timed
+// alongside for comparison.
+//
+// It then times every flip_levels kernel the CPU can run on an array of random states
+// with counts, like the model's histogram of states, for the top slot, which about half
+// the states hold and change with, and for the middle one, where few change.
+//
+// usage: hcp_hcg_bench [nodes] [pairs] [repeats] [states]
+//
+
+#include "hierarchical_model.h"
+#include "hcg_kernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace {
+    struct node_pair {
+        int32_t u;
+        int32_t v;
+    };
+
+    std::size_t smeared_slot(uint64_t a, uint64_t b) {
+        uint64_t common_bits = a&b;
+        common_bits |= (common_bits>>1UL);
+        common_bits |= (common_bits>>2UL);
+        common_bits |= (common_bits>>4UL);
+        common_bits |= (common_bits>>8UL);
+        common_bits |= (common_bits>>16UL);
+        common_bits |= (common_bits>>32UL);
+        return (63UL - __builtin_clzll((common_bits - (common_bits>>1UL))));
+    }
+
+    // best time of the repeats, in nanoseconds per pair
+    template <typename state_t, typename F>
+    double time_pairs(const std::vector<state_t> &g, const std::vector<node_pair> &pairs, int repeats,
+                      F kernel, std::size_t &checksum) {
+        double best = 1e300;
+        for (int r = 0; r < repeats; ++r){
+            std::size_t sum = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (const node_pair &p : pairs){
+                sum += kernel(g[p.u], g[p.v]);
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            best = std::min(best, seconds);
+            checksum = sum;
+        }
+        return 1e9*best/pairs.size();
+    }
+
+    template <typename state_t>
+    std::vector<state_t> random_states(int nodes, std::mt19937_64 &gen) {
+        std::vector<state_t> g(nodes);
+        for (state_t &state : g){
+            if constexpr (std::is_integral<state_t>::value){
+                state = static_cast<state_t>(gen()) | 1;
+            }else{
+                for (uint64_t &word : state.word){
+                    word = gen();
+                }
+                state.word[0] |= 1;
+            }
+        }
+        return g;
+    }
+
+    template <typename state_t>
+    void report(const std::string &name, const std::vector<node_pair> &pairs, int nodes, int repeats,
+                std::mt19937_64 &gen) {
+        std::vector<state_t> g = random_states<state_t>(nodes, gen);
+        std::size_t checksum = 0;
+        double ns = time_pairs(g, pairs, repeats, highest_common_slot<state_t>, checksum);
+        std::cout<<name<<"\t"<<ns<<"\t"<<1e3/ns<<"\t"<<checksum<<std::endl;
+    }
+
+    template <typename state_t>
+    void report_flips(const std::string &name, int num_states, int repeats, std::mt19937_64 &gen) {
+        std::vector<state_t> states = random_states<state_t>(num_states, gen);
+        std::vector<long long> counts(num_states);
+        for (long long &count : counts){
+            count = 1 + gen()%8;
+        }
+        state_t node = random_states<state_t>(1, gen)[0];
+        int bits = 8*sizeof(state_t);
+        std::vector<simd_level> kernels = {simd_level::scalar};
+        if constexpr (std::is_integral<state_t>::value){
+            for (simd_level simd : {simd_level::avx2, simd_level::avx512}){
+                if (simd <= detect_simd()){
+                    kernels.push_back(simd);
+                }
+            }
+        }
+        for (int k : {bits-1, bits/2}){
+            state_t base = node & ~slot_bit<state_t>(k);
+            for (simd_level simd : kernels){
+                flip_kernel<state_t> kernel = get_flip_kernel<state_t>(simd);
+                std::vector<long long> level(bits);
+                double best = 1e300;
+                long long checksum = 0;
+                for (int r = 0; r < repeats; ++r){
+                    std::fill(level.begin(), level.end(), 0);
+                    auto start = std::chrono::steady_clock::now();
+                    long long total = kernel(states.data(), counts.data(), states.size(), base, k, level.data());
+                    best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+                    checksum = total;
+                    for (int q = 0; q < bits; ++q){
+                        checksum += q*level[q];
+                    }
+                }
+                double ns = 1e9*best/states.size();
+                std::cout<<name<<"\t"<<simd_name(simd)<<"\t"<<k<<"\t"<<ns<<"\t"<<1e3/ns<<"\t"<<checksum<<std::endl;
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 5){
+        std::cerr<<"usage: "<<argv[0]<<" [nodes] [pairs] [repeats] [states]"<<std::endl;
+        return EXIT_FAILURE;
+    }
+    int nodes = (argc > 1) ? std::stoi(argv[1]) : 1<<20;
+    long num_pairs = (argc > 2) ? std::stol(argv[2]) : 1L<<24;
+    int repeats = (argc > 3) ? std::stoi(argv[3]) : 5;
+    int num_states = (argc > 4) ? std::stoi(argv[4]) : 4096;
+
+    std::mt19937_64 gen(1);
+    std::uniform_int_distribution<int32_t> node(0, nodes-1);
+    std::vector<node_pair> pairs(num_pairs);
+    for (node_pair &p : pairs){
+        p = {node(gen), node(gen)};
+    }
+
+    std::cout<<"state\tns/pair\tMpairs/s\tchecksum"<<std::endl;
+    {
+        std::vector<uint64_t> g = random_states<uint64_t>(nodes, gen);
+        std::size_t checksum = 0;
+        double ns = time_pairs(g, pairs, repeats, smeared_slot, checksum);
+        std::cout<<"smear64\t"<<ns<<"\t"<<1e3/ns<<"\t"<<checksum<<std::endl;
+    }
+    report<uint8_t>("uint8", pairs, nodes, repeats, gen);
+    report<uint16_t>("uint16", pairs, nodes, repeats, gen);
+    report<uint32_t>("uint32", pairs, nodes, repeats, gen);
+    report<uint64_t>("uint64", pairs, nodes, repeats, gen);
+    report<wide_state<2>>("wide128", pairs, nodes, repeats, gen);
+    report<wide_state<4>>("wide256", pairs, nodes, repeats, gen);
+    report<wide_state<8>>("wide512", pairs, nodes, repeats, gen);
+
+    std::cout<<std::endl<<"state\tkernel\tslot\tns/state\tMstates/s\tchecksum"<<std::endl;
+    report_flips<uint8_t>("uint8", num_states, repeats, gen);
+    report_flips<uint16_t>("uint16", num_states, repeats, gen);
+    report_flips<uint32_t>("uint32", num_states, repeats, gen);
+    report_flips<uint64_t>("uint64", num_states, repeats, gen);
+    report_flips<wide_state<2>>("wide128", num_states, repeats, gen);
+    report_flips<wide_state<4>>("wide256", num_states, repeats, gen);
+    report_flips<wide_state<8>>("wide512", num_states, repeats, gen);
+    return 0;
+}
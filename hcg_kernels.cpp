@@ -0,0 +1,241 @@
+//
+// Scalar, AVX2 and AVX-512 kernels for the levels that change when a slot flips.
+//
+// The vector kernels test a register of states at once for holding slot k and for
+// sharing nothing with base above it, and only fall back to scalar code for the lanes
+// that pass, adding their weights to the levels one by one. Narrow states are widened
+// to 32-bit lanes; AVX2 has no leading zero count, so the highest set bit of a lane is
+// read from the exponent of its conversion to float.
+//
+
+#include "hcg_kernels.h"
+#include <cassert>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HCP_X86_KERNELS
+#endif
+
+namespace {
+    template <typename state_t>
+    long long flip_levels_scalar(const state_t *states, const long long *weights, std::size_t n,
+                                 const state_t &base, int k, long long *level) {
+        // every state shares slot 0 with base, so each has a highest common slot; the vector
+        // kernels end here for their last states, so this checks them too
+        assert(k > 0 && has_slot(base, 0));
+        // a state changes exactly when its highest common slot with base and k is k,
+        // which needs one branch where testing for k and for the slots above needs two
+        state_t with_slot = base | slot_bit<state_t>(k);
+        long long total = 0;
+        for (std::size_t i = 0; i < n; ++i){
+            if (highest_common_slot(with_slot, states[i]) == static_cast<std::size_t>(k)){
+                long long weight = (weights != NULL) ? weights[i] : 1;
+                level[highest_common_slot(base, states[i])] += weight;
+                total += weight;
+            }
+        }
+        return total;
+    }
+
+#ifdef HCP_X86_KERNELS
+    // Highest set bit of each 32-bit lane, 0 for an empty lane. Keeping only the top bit
+    // of every run of ones leaves the bit below the highest one clear, so the conversion
+    // cannot round up to the next power of two; the shift keeps the lane positive.
+    __attribute__((target("avx2")))
+    inline __m256i highest_slot_epi32(__m256i v) {
+        __m256i top = _mm256_andnot_si256(_mm256_srli_epi32(v, 1), v);
+        __m256i as_float = _mm256_castps_si256(_mm256_cvtepi32_ps(_mm256_srli_epi32(top, 1)));
+        __m256i exponent = _mm256_srli_epi32(as_float, 23);
+        return _mm256_max_epi32(_mm256_sub_epi32(exponent, _mm256_set1_epi32(126)), _mm256_setzero_si256());
+    }
+
+    // the same for 64-bit lanes, from the highest bit of the upper or else the lower half
+    __attribute__((target("avx2")))
+    inline __m256i highest_slot_epi64(__m256i v) {
+        __m256i halves = highest_slot_epi32(v);
+        __m256i low = _mm256_and_si256(halves, _mm256_set1_epi64x(0xFFFFFFFF));
+        __m256i high = _mm256_add_epi64(_mm256_srli_epi64(halves, 32), _mm256_set1_epi64x(32));
+        __m256i high_empty = _mm256_cmpeq_epi64(_mm256_srli_epi64(v, 32), _mm256_setzero_si256());
+        return _mm256_blendv_epi8(high, low, high_empty);
+    }
+
+    template <typename state_t>
+    __attribute__((target("avx2")))
+    inline __m256i load_epi32x8(const state_t *states) {
+        if constexpr (sizeof(state_t) == 1){
+            return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(states)));
+        }else if constexpr (sizeof(state_t) == 2){
+            return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(states)));
+        }else{
+            return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(states));
+        }
+    }
+
+    template <typename state_t>
+    __attribute__((target("avx2")))
+    long long flip_levels_avx2(const state_t *states, const long long *weights, std::size_t n,
+                               const state_t &base, int k, long long *level) {
+        long long total = 0;
+        std::size_t i = 0;
+        if constexpr (sizeof(state_t) <= 4){
+            const __m256i vbase = _mm256_set1_epi32(static_cast<int32_t>(base));
+            const __m256i vbit = _mm256_set1_epi32(static_cast<int32_t>(1U<<k));
+            const __m256i vabove = _mm256_set1_epi32(static_cast<int32_t>(~((2U<<k)-1)));
+            alignas(32) int32_t found[8];
+            for (; i+8 <= n; i += 8){
+                __m256i x = load_epi32x8(states + i);
+                __m256i common = _mm256_and_si256(x, vbase);
+                __m256i holds = _mm256_cmpeq_epi32(_mm256_and_si256(x, vbit), vbit);
+                __m256i below = _mm256_cmpeq_epi32(_mm256_and_si256(common, vabove), _mm256_setzero_si256());
+                unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_and_si256(holds, below)));
+                if (mask == 0){
+                    continue;
+                }
+                _mm256_store_si256(reinterpret_cast<__m256i*>(found), highest_slot_epi32(common));
+                for (; mask != 0; mask &= mask-1){
+                    int j = __builtin_ctz(mask);
+                    long long weight = (weights != NULL) ? weights[i+j] : 1;
+                    level[found[j]] += weight;
+                    total += weight;
+                }
+            }
+        }else{
+            const __m256i vbase = _mm256_set1_epi64x(static_cast<int64_t>(base));
+            const __m256i vbit = _mm256_set1_epi64x(static_cast<int64_t>(1ULL<<k));
+            const __m256i vabove = _mm256_set1_epi64x(static_cast<int64_t>(~((2ULL<<k)-1)));
+            alignas(32) int64_t found[4];
+            for (; i+4 <= n; i += 4){
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(states + i));
+                __m256i common = _mm256_and_si256(x, vbase);
+                __m256i holds = _mm256_cmpeq_epi64(_mm256_and_si256(x, vbit), vbit);
+                __m256i below = _mm256_cmpeq_epi64(_mm256_and_si256(common, vabove), _mm256_setzero_si256());
+                unsigned mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_and_si256(holds, below)));
+                if (mask == 0){
+                    continue;
+                }
+                _mm256_store_si256(reinterpret_cast<__m256i*>(found), highest_slot_epi64(common));
+                for (; mask != 0; mask &= mask-1){
+                    int j = __builtin_ctz(mask);
+                    long long weight = (weights != NULL) ? weights[i+j] : 1;
+                    level[found[j]] += weight;
+                    total += weight;
+                }
+            }
+        }
+        return total + flip_levels_scalar(states + i, (weights != NULL) ? weights + i : NULL, n - i, base, k, level);
+    }
+
+    template <typename state_t>
+    __attribute__((target("avx512f,avx512cd")))
+    inline __m512i load_epi32x16(const state_t *states) {
+        if constexpr (sizeof(state_t) == 1){
+            return _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(states)));
+        }else if constexpr (sizeof(state_t) == 2){
+            return _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(states)));
+        }else{
+            return _mm512_loadu_si512(states);
+        }
+    }
+
+    template <typename state_t>
+    __attribute__((target("avx512f,avx512cd")))
+    long long flip_levels_avx512(const state_t *states, const long long *weights, std::size_t n,
+                                 const state_t &base, int k, long long *level) {
+        long long total = 0;
+        std::size_t i = 0;
+        if constexpr (sizeof(state_t) <= 4){
+            const __m512i vbase = _mm512_set1_epi32(static_cast<int32_t>(base));
+            const __m512i vbit = _mm512_set1_epi32(static_cast<int32_t>(1U<<k));
+            const __m512i vabove = _mm512_set1_epi32(static_cast<int32_t>(~((2U<<k)-1)));
+            alignas(64) int32_t found[16];
+            for (; i+16 <= n; i += 16){
+                __m512i x = load_epi32x16(states + i);
+                __m512i common = _mm512_and_si512(x, vbase);
+                unsigned mask = _mm512_test_epi32_mask(x, vbit) & _mm512_testn_epi32_mask(common, vabove);
+                if (mask == 0){
+                    continue;
+                }
+                // clamped to slot 0 like the AVX2 kernel, should a state share no slot with base
+                __m512i highest = _mm512_sub_epi32(_mm512_set1_epi32(31), _mm512_lzcnt_epi32(common));
+                _mm512_store_si512(found, _mm512_max_epi32(highest, _mm512_setzero_si512()));
+                for (; mask != 0; mask &= mask-1){
+                    int j = __builtin_ctz(mask);
+                    long long weight = (weights != NULL) ? weights[i+j] : 1;
+                    level[found[j]] += weight;
+                    total += weight;
+                }
+            }
+        }else{
+            const __m512i vbase = _mm512_set1_epi64(static_cast<int64_t>(base));
+            const __m512i vbit = _mm512_set1_epi64(static_cast<int64_t>(1ULL<<k));
+            const __m512i vabove = _mm512_set1_epi64(static_cast<int64_t>(~((2ULL<<k)-1)));
+            alignas(64) int64_t found[8];
+            for (; i+8 <= n; i += 8){
+                __m512i x = _mm512_loadu_si512(states + i);
+                __m512i common = _mm512_and_si512(x, vbase);
+                unsigned mask = _mm512_test_epi64_mask(x, vbit) & _mm512_testn_epi64_mask(common, vabove);
+                if (mask == 0){
+                    continue;
+                }
+                __m512i highest = _mm512_sub_epi64(_mm512_set1_epi64(63), _mm512_lzcnt_epi64(common));
+                _mm512_store_si512(found, _mm512_max_epi64(highest, _mm512_setzero_si512()));
+                for (; mask != 0; mask &= mask-1){
+                    int j = __builtin_ctz(mask);
+                    long long weight = (weights != NULL) ? weights[i+j] : 1;
+                    level[found[j]] += weight;
+                    total += weight;
+                }
+            }
+        }
+        return total + flip_levels_scalar(states + i, (weights != NULL) ? weights + i : NULL, n - i, base, k, level);
+    }
+#endif
+}
+
+simd_level detect_simd() {
+#ifdef HCP_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512cd")){
+        return simd_level::avx512;
+    }
+    if (__builtin_cpu_supports("avx2")){
+        return simd_level::avx2;
+    }
+#endif
+    return simd_level::scalar;
+}
+
+const char *simd_name(simd_level simd) {
+    switch (simd){
+        case simd_level::avx512:
+            return "avx512";
+        case simd_level::avx2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
+
+template <typename state_t>
+flip_kernel<state_t> get_flip_kernel(simd_level simd) {
+#ifdef HCP_X86_KERNELS
+    if constexpr (std::is_integral<state_t>::value){
+        if (simd == simd_level::avx512){
+            return flip_levels_avx512<state_t>;
+        }
+        if (simd == simd_level::avx2){
+            return flip_levels_avx2<state_t>;
+        }
+    }
+#endif
+    return flip_levels_scalar<state_t>;
+}
+
+template flip_kernel<uint8_t> get_flip_kernel<uint8_t>(simd_level simd);
+template flip_kernel<uint16_t> get_flip_kernel<uint16_t>(simd_level simd);
+template flip_kernel<uint32_t> get_flip_kernel<uint32_t>(simd_level simd);
+template flip_kernel<uint64_t> get_flip_kernel<uint64_t>(simd_level simd);
+template flip_kernel<wide_state<2>> get_flip_kernel<wide_state<2>>(simd_level simd);
+template flip_kernel<wide_state<4>> get_flip_kernel<wide_state<4>>(simd_level simd);
+template flip_kernel<wide_state<8>> get_flip_kernel<wide_state<8>>(simd_level simd);
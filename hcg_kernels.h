@@ -0,0 +1,41 @@
+//
+// Kernels for the change in highest common groups when one slot of a node flips.
+//
+// Let base be the node's state without slot k. A state x only changes its highest
+// common slot with the node when x holds slot k and shares no slot above k with base;
+// it then moves between k and hcg(base, x) < k. flip_levels adds the weight of every
+// such x to level[hcg(base, x)] and returns their total weight, which is what moves to
+// or from level k. The scalar kernel works for every state type; for the integer
+// states there are AVX2 and AVX-512 kernels, picked at run time by what the CPU
+// supports. They all give the same counts, which hcp_kernel_test checks.
+//
+// Like the model's states, base and every state must hold slot 0, and k be above it.
+//
+
+#ifndef HCP_HCG_KERNELS_H
+#define HCP_HCG_KERNELS_H
+
+#include "group_state.h"
+#include <cstddef>
+
+// weights may be NULL, in which case every state weighs 1
+template <typename state_t>
+using flip_kernel = long long (*)(const state_t *states, const long long *weights, std::size_t n,
+                                  const state_t &base, int k, long long *level);
+
+enum class simd_level {
+    scalar,
+    avx2,
+    avx512
+};
+
+// the widest instruction set the CPU supports that there are kernels for
+simd_level detect_simd();
+const char *simd_name(simd_level simd);
+
+// The kernel for an instruction set, or the scalar one when there is none for this state
+// type. Asking for a set the CPU lacks is undefined.
+template <typename state_t>
+flip_kernel<state_t> get_flip_kernel(simd_level simd);
+
+#endif //HCP_HCG_KERNELS_H
@@ -3,191 +3,567 @@
 //
 
 #include "hierarchical_model.h"
+#include <algorithm>
 #include <iostream>
 #include <random>
 #include "readgml.h"
+#include "checkpoint.h"
+#include "multilevel_init.h"
+#include "thread_pool.h"
 #include <gsl/gsl_rng.h>
 #include <gsl/gsl_randist.h>
 
+namespace {
+    // below these the initial counts are made on one thread
+    const int64_t PARALLEL_COUNT_EDGES = 1<<20; // adjacency entries
+    const double PARALLEL_COUNT_PAIRS = 1<<24; // pairs of distinct states
+    const int MAX_SUBSET_BITS = 22; // most groups above group 0 the pairs are counted by subsets for
+
+    // runs f(p) for every p in [0, parts), on a thread each when there are several
+    template <typename F>
+    void run_parts(int parts, F f) {
+        if (parts == 1){
+            f(0);
+            return;
+        }
+        thread_pool pool(parts);
+        for (int p = 0; p < parts; ++p){
+            pool.submit([&f, p]() { f(p); });
+        }
+        pool.wait();
+    }
+}
 
-hierarchical_model::hierarchical_model(parameters params){
-    std::cout<<"reading in network"<<std::endl;
-    std::string network_path = params.get_gml_path();
-    read_network(&G, network_path);
+hierarchical_model::hierarchical_model(const parameters &params, const NETWORK &network, unsigned long seed,
+                                       int num_slots)
+    : num_slots(num_slots), G(network) {
     num_groups = params.get_initial_num_groups();
     max_num_groups = params.get_max_num_groups();
+    gibbs_fraction = params.get_gibbs_fraction();
+    gibbs_max_groups = params.get_gibbs_max_groups();
+    setup_threads = params.get_read_threads();
 
     rng = gsl_rng_alloc(gsl_rng_mt19937);
-    gsl_rng_set(rng,time(NULL));
+    gsl_rng_set(rng,seed);
+
+    group_slot.reserve(max_num_groups);
+    spread_group_slots();
+    slot_remap.assign(num_slots, -1);
+
+    // everything the sampler touches is sized for the worst case up front, so proposing
+    // and undoing moves never allocates
+    undo_log.reserve(2*num_slots+8);
+
+    hcg_edges.assign(num_slots, 0);
+    hcg_pairs.assign(num_slots, 0);
+    group_size.assign(num_slots, 0);
+    nodes_in.set_ncols(G.nvertices, num_slots);
+    nodes_out.set_ncols(G.nvertices, num_slots);
+
+    level_touched.assign(num_slots, 0);
+    pair_moves.assign(num_slots, 0);
+    edge_moves.assign(num_slots, 0);
+    touched_levels.reserve(max_num_groups);
+    touched_loglike.reserve(max_num_groups);
+    join_weight.assign(max_num_groups, 0.0);
+    if (gibbs_fraction > 0.0){
+        gibbs_weights.reserve(1UL<<(std::min(gibbs_max_groups, max_num_groups)-1));
+    }
+}
 
+template <typename state_t>
+width_model<state_t>::width_model(const parameters &params, const NETWORK &network, unsigned long seed)
+    : hierarchical_model(params, network, seed, 8*sizeof(state_t)),
+      flip_levels(get_flip_kernel<state_t>(detect_simd())) {
     if (params.get_initial_group_config().empty()){
         std::cout<<"assigning random groups to nodes"<<std::endl;
         g.assign(G.nvertices, 0);
         partition();
     }else{
         std::cout<<"assigning user specified groups to nodes"<<std::endl;
-        g = params.get_initial_group_config();
+        const std::vector<uint64_t> &config = params.get_initial_group_config();
+        g.assign(config.size(), 0);
+        for (std::size_t u = 0; u < config.size(); ++u){
+            g[u] = to_slots(config[u]);
+        }
     }
 
-    hcg_edges.assign(num_groups, 0);
-    hcg_pairs.assign(num_groups, 0);
+    bit_groups.reserve(G.nvertices);
+    set_counts();
 
-    set_nodes_in_out();
-    set_hcg_edges();
-    set_hcg_pairs();
+    use_neighbour_histograms(params.get_neighbour_histograms());
+}
 
-    for(int i = 0; i < log_fact.size(); ++i){
-        log_fact[i] = ln_fact(i);
+std::unique_ptr<hierarchical_model> make_width_model(const parameters &params, const NETWORK &network, unsigned long seed) {
+    int max_groups = params.get_max_num_groups();
+    if (2*max_groups <= 8){
+        return std::make_unique<width_model<uint8_t>>(params, network, seed);
     }
+    if (2*max_groups <= 16){
+        return std::make_unique<width_model<uint16_t>>(params, network, seed);
+    }
+    if (2*max_groups <= 32){
+        return std::make_unique<width_model<uint32_t>>(params, network, seed);
+    }
+    if (max_groups <= 64){
+        return std::make_unique<width_model<uint64_t>>(params, network, seed);
+    }
+    if (max_groups <= 128){
+        return std::make_unique<width_model<wide_state<2>>>(params, network, seed);
+    }
+    if (max_groups <= 256){
+        return std::make_unique<width_model<wide_state<4>>>(params, network, seed);
+    }
+    return std::make_unique<width_model<wide_state<8>>>(params, network, seed);
+}
 
-    loglike = calc_loglike();
-
+std::unique_ptr<hierarchical_model> make_model(const parameters &params, const NETWORK &network, unsigned long seed) {
+    std::unique_ptr<hierarchical_model> model = make_width_model(params, network, seed);
+    if (use_multilevel_start(params)){
+        multilevel_start(*model, params, seed);
+    }
+    return model;
 }
 
 
-double hierarchical_model::ln_fact(int arg){
-    return lgamma(arg+1);
+hierarchical_model::~hierarchical_model(){
+    gsl_rng_free(rng);
 }
 
+// Spreads the groups evenly over the slots so new groups can usually be slotted in between
+void hierarchical_model::spread_group_slots() {
+    group_slot.clear();
+    for (int r = 0; r < num_groups; ++r){
+        group_slot.push_back(r*num_slots/num_groups);
+    }
+}
 
-void hierarchical_model::partition() {
+// Counts everything that follows from the states: the node lists, the histogram of
+// states, the edges and pairs in each group and the likelihood
+template <typename state_t>
+void width_model<state_t>::set_counts() {
+    set_nodes_in_out();
+    set_bit_groups();
+    std::fill(hcg_edges.begin(), hcg_edges.end(), 0);
+    std::fill(hcg_pairs.begin(), hcg_pairs.end(), 0);
+    set_hcg_edges();
+    set_hcg_pairs();
 
-    uint64_t max = (1UL<<(num_groups-1));
+    set_level_loglike();
+    loglike = calc_loglike();
+}
 
+template <typename state_t>
+void width_model<state_t>::set_groups(const std::vector<uint64_t>& groups, int groups_count) {
+    num_groups = groups_count;
+    spread_group_slots();
+    std::size_t words = group_words();
     for (int u = 0; u < G.nvertices; ++u){
-        g[u] = (gsl_rng_uniform_int(rng, max)<<1UL)+1;
+        g[u] = from_groups(groups.data() + u*words);
+    }
+    set_counts();
+    if (neighbour_histograms){
+        neighbour_states.build(G, g);
     }
 }
 
-inline std::size_t hierarchical_model::hcg(int u, int v){
-
-    uint64_t group_mask = (1UL<<num_groups)-1;
-    uint64_t masked_u = g[u] & group_mask;
-    uint64_t masked_v = g[v] & group_mask;
-
-    uint64_t common_bits = masked_u&masked_v;
-    common_bits |= (common_bits>>1UL);
-    common_bits |= (common_bits>>2UL);
-    common_bits |= (common_bits>>4UL);
-    common_bits |= (common_bits>>8UL);
-    common_bits |= (common_bits>>16UL);
-    common_bits |= (common_bits>>32UL);
+// Puts every node in group 0 and in each other group at random. The other groups are
+// drawn 31 at a time, as gsl_rng_uniform_int cannot draw 32 bits from mt19937 at once.
+template <typename state_t>
+void width_model<state_t>::partition() {
 
-    return (63UL - __builtin_clzll((common_bits - (common_bits>>1UL))));
+    for (int u = 0; u < G.nvertices; ++u){
+        state_t state = slot_bit<state_t>(group_slot[0]);
+        for (int r = 1; r < num_groups; r += 31){
+            int bits = std::min(31, num_groups - r);
+            uint64_t groups = gsl_rng_uniform_int(rng, 1UL<<bits);
+            for (int b = 0; b < bits; ++b){
+                if ((groups>>b)&1UL){
+                    state |= slot_bit<state_t>(group_slot[r+b]);
+                }
+            }
+        }
+        g[u] = state;
+    }
 }
 
-inline std::size_t hierarchical_model::hcg_node(const uint64_t& old_state, int u) {
-
-    uint64_t group_mask = (1UL<<num_groups)-1;
-    uint64_t masked_u = old_state & group_mask;
-    uint64_t masked_v = g[u] & group_mask;
-
-    uint64_t common_bits = masked_u&masked_v;
-    common_bits |= (common_bits>>1UL);
-    common_bits |= (common_bits>>2UL);
-    common_bits |= (common_bits>>4UL);
-    common_bits |= (common_bits>>8UL);
-    common_bits |= (common_bits>>16UL);
-    common_bits |= (common_bits>>32UL);
-
-    return (63UL - __builtin_clzll((common_bits - (common_bits>>1UL))));
+template <typename state_t>
+inline std::size_t width_model<state_t>::hcg(int u, int v){
+    return highest_common_slot(g[u], g[v]);
 }
 
-void hierarchical_model::set_hcg_edges(){
-    for (int u = 0; u < G.nvertices; ++u){
-        for (int w = 0; w < G.vertex[u].degree; ++w){
-            int v = G.vertex[u].edge[w].target;
-            if (u < v){
-                std::size_t highest = hcg(u, v);
-                hcg_edges[highest]++;
+// Counts the edges in each group. On large networks the vertices are split into
+// ranges of about equal numbers of edges, one per setup thread, each counting into its
+// own histogram of levels, and the histograms are summed.
+template <typename state_t>
+void width_model<state_t>::set_hcg_edges(){
+    int n = G.nvertices;
+    int parts = (G.offset[n] >= PARALLEL_COUNT_EDGES) ? setup_threads : 1;
+    std::vector<std::vector<long long>> levels(parts, std::vector<long long>(num_slots, 0));
+    auto first_vertex = [&](int p) -> int {
+        return (p == parts) ? n : std::lower_bound(G.offset, G.offset+n, G.offset[n]*p/parts) - G.offset;
+    };
+    auto count = [&](int p) {
+        long long *level = levels[p].data();
+        for (int u = first_vertex(p); u < first_vertex(p+1); ++u){
+            for (int64_t e = G.offset[u]; e < G.offset[u+1]; ++e){
+                int v = G.target[e];
+                if (u < v){
+                    level[hcg(u, v)]++;
+                }
             }
         }
+    };
+    run_parts(parts, count);
+    for (int p = 0; p < parts; ++p){
+        for (int s = 0; s < num_slots; ++s){
+            hcg_edges[s] += levels[p][s];
+        }
     }
 }
 
-std::vector<std::vector<int>> hierarchical_model::get_group_matrix(){
+template <typename state_t>
+std::vector<std::vector<int>> width_model<state_t>::get_group_matrix(){
     std::vector<std::vector<int>> group_matrix;
 
     for(int u = 0; u < G.nvertices; ++u){
         std::vector<int> group_col;
         for(int r =  0; r < num_groups; ++r){
-            group_col.push_back((g[u] >> r)&1);
+            group_col.push_back(has_slot(g[u], group_slot[r]));
         }
         group_matrix.push_back(group_col);
     }
     return group_matrix;
 }
 
-void hierarchical_model::set_hcg_pairs() {
-    for(int u = 0; u < G.nvertices; ++u){
-        for(int v = u+1; v < G.nvertices; ++v){
-            hcg_pairs[hcg(u, v)]++;
+// Counts the pairs in each group from the histogram of states rather than over every
+// pair of nodes, in whichever of two ways is cheaper. With D distinct states and K
+// groups, set_hcg_pairs_by_states takes O(D^2) and set_hcg_pairs_by_subsets O(2^K K).
+// The pairs sharing no group but group 0 are those of orthogonal vectors, so when there
+// are many groups and nearly as many states as nodes, neither is near-linear.
+template <typename state_t>
+void width_model<state_t>::set_hcg_pairs() {
+    double size = bit_groups.size();
+    int bits = num_groups-1;
+    if (bits <= MAX_SUBSET_BITS && 2.0*bits*(1UL<<bits) + size*num_groups < size*size/2){
+        set_hcg_pairs_by_subsets();
+    }else{
+        set_hcg_pairs_by_states();
+    }
+}
+
+// The pairs of nodes sharing a state s have their highest common group at the highest
+// slot of s, and the pairs between states s and t at hcg(s, t). Many pairs of states
+// are split over the setup threads, every thread taking every parts-th state.
+template <typename state_t>
+void width_model<state_t>::set_hcg_pairs_by_states() {
+    const state_t *states = bit_groups.states();
+    const long long *counts = bit_groups.counts();
+    std::size_t size = bit_groups.size();
+    int parts = (0.5*size*size >= PARALLEL_COUNT_PAIRS) ? setup_threads : 1;
+    std::vector<std::vector<long long>> levels(parts, std::vector<long long>(num_slots, 0));
+    run_parts(parts, [&](int p) {
+        long long *level = levels[p].data();
+        for (std::size_t i = p; i < size; i += parts){
+            level[highest_common_slot(states[i], states[i])] += counts[i]*(counts[i]-1)/2;
+            for (std::size_t j = i+1; j < size; ++j){
+                level[highest_common_slot(states[i], states[j])] += counts[i]*counts[j];
+            }
+        }
+    });
+    for (int p = 0; p < parts; ++p){
+        for (int s = 0; s < num_slots; ++s){
+            hcg_pairs[s] += levels[p][s];
         }
     }
 }
 
-void hierarchical_model::set_nodes_in_out() {
-    std::vector<std::vector<int>> group_matrix = get_group_matrix();
+// The pairs whose highest common group is r are the pairs of nodes in r that share no
+// group above r. Writing the groups above r of every node in r as a set x, with c(x)
+// nodes each, the nodes whose groups above r lie within y number F(y), the sum of c over
+// the subsets of y, which a sum over subsets gives for every y at once. Each node in r
+// with groups x then pairs with the F(complement of x) nodes sharing none of them.
+template <typename state_t>
+void width_model<state_t>::set_hcg_pairs_by_subsets() {
+    const state_t *states = bit_groups.states();
+    const long long *counts = bit_groups.counts();
+    std::size_t size = bit_groups.size();
+    int bits = num_groups-1;
+
+    // bit r-1 of masks[i] is set if state i holds group r
+    std::vector<uint32_t> masks(size, 0);
+    for (std::size_t i = 0; i < size; ++i){
+        for (int r = 1; r < num_groups; ++r){
+            if (has_slot(states[i], group_slot[r])){
+                masks[i] |= 1U<<(r-1);
+            }
+        }
+    }
 
-    for(std::size_t r = 0; r < num_groups; ++r){
-        nodes_in.push_back(std::vector<int>(G.nvertices, -1));
-        nodes_out.push_back(std::vector<int>(G.nvertices, -1));
+    std::vector<long long> nodes(1UL<<bits);
+    std::vector<long long> within(1UL<<bits);
+    for (int r = 0; r < num_groups; ++r){
+        int above = bits - r;
+        std::size_t sets = 1UL<<above;
+        std::fill_n(nodes.begin(), sets, 0);
+        for (std::size_t i = 0; i < size; ++i){
+            if (r == 0 || ((masks[i]>>(r-1))&1U)){
+                nodes[masks[i]>>r] += counts[i];
+            }
+        }
+        std::copy_n(nodes.begin(), sets, within.begin());
+        for (int b = 0; b < above; ++b){
+            for (std::size_t y = 0; y < sets; ++y){
+                if ((y>>b)&1U){
+                    within[y] += within[y^(1UL<<b)];
+                }
+            }
+        }
+        // ordered pairs of nodes, less each node in no group above r paired with itself
+        long long ordered = 0;
+        for (std::size_t x = 0; x < sets; ++x){
+            ordered += nodes[x]*within[(sets-1)^x];
+        }
+        hcg_pairs[group_slot[r]] += (ordered - nodes[0])/2;
+    }
+}
+
+// Rebuilds the in/out node lists of every slot. Free slots list every node as out,
+// so a group placed in one later starts out valid without touching the lists.
+template <typename state_t>
+void width_model<state_t>::set_nodes_in_out() {
+    for(int s = 0; s < num_slots; ++s){
         int in_g = 0;
         int out_g = 0;
         for (int u = 0; u < G.nvertices; ++u){
-            if (group_matrix[u][r]== 1){
-                nodes_in.at(in_g, r) = u;
+            if (has_slot(g[u], s)){
+                nodes_in.at(s, in_g) = u;
                 in_g++;
             }else{
-                nodes_out.at(out_g, r) = u;
+                nodes_out.at(s, out_g) = u;
                 out_g++;
             }
         }
-        group_size.push_back(in_g);
+        group_size[s] = in_g;
+    }
+}
+
+// The pair counts only depend on how many nodes hold each distinct group state, so
+// we keep a histogram of states. Moving a node then costs O(number of distinct states)
+// instead of O(N).
+
+template <typename state_t>
+void width_model<state_t>::set_bit_groups() {
+    bit_groups.clear();
+    for (int u = 0; u < G.nvertices; ++u){
+        bit_groups.add(g[u]);
+    }
+}
+
+template <typename state_t>
+void width_model<state_t>::use_neighbour_histograms(bool enabled) {
+    neighbour_histograms = enabled;
+    if (enabled){
+        neighbour_states.build(G, g);
+    }else{
+        neighbour_states.clear();
+    }
+}
+
+template <typename state_t>
+std::size_t width_model<state_t>::neighbour_histogram_bytes() const {
+    return neighbour_states.bytes();
+}
+
+// Groups are stored in physical bit slots of the state rather than at their hierarchy
+// position. group_slot lists the slot of each group in hierarchy order and is kept
+// increasing, so the highest common slot of two states is still their highest common
+// group. Adding or removing a group only edits group_slot, unless the new group has
+// no free slot between its neighbours and the groups have to be spread out again.
+
+template <typename state_t>
+state_t width_model<state_t>::to_slots(uint64_t groups) {
+    state_t state = 0;
+    for (int r = 0; r < std::min(num_groups, 64); ++r){
+        if ((groups>>r)&1UL){
+            state |= slot_bit<state_t>(group_slot[r]);
+        }
+    }
+    return state;
+}
+
+// Reads a state from group_words() words, group r in bit r%64 of word r/64
+template <typename state_t>
+state_t width_model<state_t>::from_groups(const uint64_t *groups) {
+    state_t state = 0;
+    for (int r = 0; r < num_groups; ++r){
+        if ((groups[r>>6]>>(r&63))&1UL){
+            state |= slot_bit<state_t>(group_slot[r]);
+        }
+    }
+    return state;
+}
+
+// Writes the groups of a state into group_words() words, group r in bit r%64 of word r/64
+template <typename state_t>
+void width_model<state_t>::to_groups(const state_t &state, uint64_t *groups) {
+    std::fill(groups, groups + group_words(), 0);
+    for (int r = 0; r < num_groups; ++r){
+        groups[r>>6] |= static_cast<uint64_t>(has_slot(state, group_slot[r]))<<(r&63);
+    }
+}
+
+// Inserts an empty group at hierarchy position r and returns its slot
+int hierarchical_model::insert_group(int r) {
+    int lo = group_slot[r-1];
+    int hi = (r < num_groups) ? group_slot[r] : num_slots;
+    if (hi - lo < 2){
+        respread_slots(r);
+        lo = group_slot[r-1];
+        hi = (r < num_groups) ? group_slot[r] : num_slots;
+    }
+    int slot = (lo + hi)/2;
+    place_group(r, slot);
+    return slot;
+}
+
+// Puts an empty group at hierarchy position r into the free slot given
+void hierarchical_model::place_group(int r, int slot) {
+    group_slot.insert(group_slot.begin() + r, slot);
+    num_groups++;
+}
+
+// Removes the empty group at hierarchy position r and returns the slot it freed
+int hierarchical_model::remove_group(int r) {
+    int slot = group_slot[r];
+    group_slot.erase(group_slot.begin() + r);
+    num_groups--;
+    return slot;
+}
+
+// Removes every empty group but group 0. An empty group has no pairs, so this leaves
+// the likelihood unchanged.
+void hierarchical_model::remove_empty_groups() {
+    for (int r = num_groups-1; r >= 1; --r){
+        if (group_size[group_slot[r]] == 0){
+            remove_group(r);
+        }
+    }
+}
+
+// Spreads the groups evenly over the slots, leaving a free slot at hierarchy position
+// hole. Every state is rewritten, so this costs O(N*num_groups), but it only happens
+// when a gap between neighbouring groups has been used up.
+template <typename state_t>
+void width_model<state_t>::respread_slots(int hole) {
+    std::fill(slot_remap.begin(), slot_remap.end(), -1);
+    for (int r = 0; r < num_groups; ++r){
+        int pos = (r < hole) ? r : r+1;
+        slot_remap[group_slot[r]] = pos*num_slots/(num_groups+1);
+    }
+
+    for (int u = 0; u < G.nvertices; ++u){
+        state_t state = 0;
+        for (int r = 0; r < num_groups; ++r){
+            if (has_slot(g[u], group_slot[r])){
+                state |= slot_bit<state_t>(slot_remap[group_slot[r]]);
+            }
+        }
+        g[u] = state;
+    }
+
+    // the remap is increasing, so moving groups down in ascending order and up in
+    // descending order never overwrites a slot that has not been moved yet
+    for (int r = 0; r < num_groups; ++r){
+        if (slot_remap[group_slot[r]] < group_slot[r]){
+            move_slot(group_slot[r], slot_remap[group_slot[r]]);
+        }
+    }
+    for (int r = num_groups-1; r >= 0; --r){
+        if (slot_remap[group_slot[r]] > group_slot[r]){
+            move_slot(group_slot[r], slot_remap[group_slot[r]]);
+        }
+    }
+    for (int r = 0; r < num_groups; ++r){
+        group_slot[r] = slot_remap[group_slot[r]];
+    }
+
+    set_nodes_in_out();
+    set_bit_groups();
+    if (neighbour_histograms){
+        neighbour_states.build(G, g);
     }
 }
 
-inline uint64_t hierarchical_model::remove_bit_at(uint64_t val, std::size_t pos) {
-    uint64_t group_mask = (1UL<<num_groups)-1;
-    uint64_t upper_mask = (group_mask<<(pos+1))&group_mask;
-    uint64_t lower_mask = (group_mask>>(num_groups-pos))&group_mask;
+// Moves the counts of slot from into the free slot to
+void hierarchical_model::move_slot(int from, int to) {
+    hcg_edges[to] = hcg_edges[from];
+    hcg_pairs[to] = hcg_pairs[from];
+    level_loglike[to] = level_loglike[from];
+    hcg_edges[from] = 0;
+    hcg_pairs[from] = 0;
+    level_loglike[from] = 0.0;
+}
 
-    uint64_t upper = val&upper_mask;
-    uint64_t lower = val&lower_mask;
+std::vector<uint64_t> hierarchical_model::get_g() {
+    std::vector<uint64_t> groups;
+    get_g(groups);
+    return groups;
+}
 
-    return ((upper>>1) | lower);
+// Fills groups in place, so a buffer that is reused does not reallocate
+template <typename state_t>
+void width_model<state_t>::get_g(std::vector<uint64_t>& groups) {
+    std::size_t words = group_words();
+    groups.resize(G.nvertices*words);
+    for (int u = 0; u < G.nvertices; ++u){
+        to_groups(g[u], groups.data() + u*words);
+    }
 }
 
-inline uint64_t hierarchical_model::insert_zero_at(uint64_t val, std::size_t pos) {
+std::vector<long long> hierarchical_model::by_group(const std::vector<long long>& by_slot) {
+    std::vector<long long> values;
+    by_group(by_slot, values);
+    return values;
+}
 
-    uint64_t group_mask = (1UL<<num_groups)-1;
-    uint64_t select_mask = (group_mask<<pos)&group_mask;
+void hierarchical_model::by_group(const std::vector<long long>& by_slot, std::vector<long long>& values) {
+    values.resize(num_groups);
+    for (int r = 0; r < num_groups; ++r){
+        values[r] = by_slot[group_slot[r]];
+    }
+}
 
-    uint64_t left = val&select_mask;
-    uint64_t right = val&(~select_mask);
+std::vector<long long> hierarchical_model::get_hcg_edges() {
+    return by_group(hcg_edges);
+}
 
-    return ((left<<1) | right);
+std::vector<long long> hierarchical_model::get_hcg_pairs() {
+    return by_group(hcg_pairs);
+}
 
+std::vector<long long> hierarchical_model::get_group_size() {
+    return by_group(group_size);
 }
 
 void hierarchical_model::print_hcg_pairs() {
     std::cout<<"number of pairs: ";
     for(int q = 0; q < num_groups; ++q){
-        std::cout<<hcg_pairs[q]<<" ";
+        std::cout<<hcg_pairs[group_slot[q]]<<" ";
     }
 }
 
 void hierarchical_model::print_hcg_edges() {
     std::cout<<"number of edges: ";
     for (int q = 0; q < num_groups; ++q){
-        std::cout<<hcg_edges[q]<<" ";
+        std::cout<<hcg_edges[group_slot[q]]<<" ";
     }
 }
 
 void hierarchical_model::print_group_size() {
     std::cout<<"group sizes: ";
     for (int q = 0; q < num_groups; ++q){
-        std::cout<<group_size[q]<<" ";
+        std::cout<<group_size[group_slot[q]]<<" ";
     }
 }
 
@@ -202,50 +578,256 @@ void hierarchical_model::print_g() {
     }
 }
 
-void hierarchical_model::update_hcg_props(int u, const uint64_t& old_state){
-    for (int v = 0; v < u; ++v){
-        int nh = hcg(u, v);
-        int old = hcg_node(old_state, v);
-        hcg_pairs.at(old)--;
-        hcg_pairs.at(nh)++;
+// A move flips one slot of u. Only the nodes holding that slot and sharing nothing with
+// u above it change their highest common slot with u: they move between the slot and
+// the level below it that flip_levels finds. Both the pairs, through the histogram of
+// states, and the edges, through u's neighbour histogram or its neighbours in blocks,
+// are counted by that level, and the levels are then updated in increasing order, so
+// the result does not depend on which kernel ran or whether the histograms are kept.
+template <typename state_t>
+void width_model<state_t>::update_hcg_props(int u, const state_t& old_state, int slot){
+    state_t new_state = g[u];
+    bool added = has_slot(new_state, slot);
+    const state_t &base = added ? old_state : new_state;
+
+    bit_groups.remove(old_state);
+    long long moved_pairs = flip_levels(bit_groups.states(), bit_groups.counts(), bit_groups.size(), base, slot,
+                                        pair_moves.data());
+    bit_groups.add(new_state);
+
+    long long moved_edges = 0;
+    if (neighbour_histograms){
+        moved_edges = flip_levels(neighbour_states.states(u), neighbour_states.counts(u), neighbour_states.size(u),
+                                  base, slot, edge_moves.data());
+    }else{
+        state_t neighbours[64];
+        for (int64_t e = G.offset[u]; e < G.offset[u+1]; e += 64){
+            std::size_t block = std::min<int64_t>(64, G.offset[u+1] - e);
+            for (std::size_t j = 0; j < block; ++j){
+                neighbours[j] = g[G.target[e+j]];
+            }
+            moved_edges += flip_levels(neighbours, NULL, block, base, slot, edge_moves.data());
+        }
     }
 
-    for (int v = u+1; v < G.nvertices; ++v){
-        int nh = hcg(u, v);
-        int old = hcg_node(old_state, v);
-        hcg_pairs.at(old)--;
-        hcg_pairs.at(nh)++;
+    // an added slot takes the moving pairs and edges from the levels below, a removed
+    // one gives them back
+    long long sign = added ? 1 : -1;
+    for (int q = 0; q < slot; ++q){
+        if (pair_moves[q] != 0 || edge_moves[q] != 0){
+            touch_level(q);
+            hcg_pairs[q] -= sign*pair_moves[q];
+            hcg_edges[q] -= sign*edge_moves[q];
+            pair_moves[q] = 0;
+            edge_moves[q] = 0;
+        }
     }
+    if (moved_pairs != 0 || moved_edges != 0){
+        touch_level(slot);
+        hcg_pairs[slot] += sign*moved_pairs;
+        hcg_edges[slot] += sign*moved_edges;
+    }
+}
 
-    for(int w = 0; w < G.vertex[u].degree; ++w){
-        int v = G.vertex[u].edge[w].target;
-        int nh = hcg(u, v);
-        int old = hcg_node(old_state, v);
-        hcg_edges.at(old)--;
-        hcg_edges.at(nh)++;
+// Adds to levels[q] the number of u's edges whose highest common slot would be q if u
+// held state, for any candidate state of u
+template <typename state_t>
+void width_model<state_t>::edge_levels(int u, const state_t& state, long long *levels){
+    if (neighbour_histograms){
+        const state_t *states = neighbour_states.states(u);
+        const long long *counts = neighbour_states.counts(u);
+        for (std::size_t i = 0; i < neighbour_states.size(u); ++i){
+            levels[highest_common_slot(state, states[i])] += counts[i];
+        }
+    }else{
+        for (int64_t e = G.offset[u]; e < G.offset[u+1]; ++e){
+            levels[highest_common_slot(state, g[G.target[e]])]++;
+        }
     }
 }
 
 double hierarchical_model::calc_loglike() {
     double res = 0.0;
-    for (int q = 0; q < num_groups; ++q){
-        res+=(log_fact[hcg_edges[q]] + log_fact[hcg_pairs[q] - hcg_edges[q]]);
-        res-=(log_fact[hcg_pairs[q]+1]);
+    for (int r = 0; r < num_groups; ++r){
+        int q = group_slot[r];
+        res+=(log_fact(hcg_edges[q]) + log_fact(hcg_pairs[q] - hcg_edges[q]));
+        res-=(log_fact(hcg_pairs[q]+1));
     }
 
     return res;
 }
 
-void hierarchical_model::update_bit(uint64_t& state, uint64_t bit, std::size_t group){
+inline double hierarchical_model::calc_level_loglike(int q) {
+    return log_fact(hcg_edges[q]) + log_fact(hcg_pairs[q] - hcg_edges[q]) - log_fact(hcg_pairs[q]+1);
+}
+
+void hierarchical_model::set_level_loglike() {
+    level_loglike.assign(num_slots, 0.0);
+    for (int r = 0; r < num_groups; ++r){
+        level_loglike[group_slot[r]] = calc_level_loglike(group_slot[r]);
+    }
+}
+
+// Must be called before the counts of group q are changed, so their old values can be undone
+inline void hierarchical_model::touch_level(int q) {
+    if (!level_touched[q]){
+        level_touched[q] = 1;
+        touched_levels.push_back(q);
+        log_undo(undo_op::hcg_edges, 0, q, hcg_edges[q]);
+        log_undo(undo_op::hcg_pairs, 0, q, hcg_pairs[q]);
+    }
+}
+
+// Change in the log-likelihood over the groups touched by the last call to update_hcg_props.
+// The proposed contributions are kept until the move is accepted or rejected.
+double hierarchical_model::calc_loglike_delta() {
+    double delta = 0.0;
+    touched_loglike.clear();
+    for (int q : touched_levels){
+        double new_ll = calc_level_loglike(q);
+        touched_loglike.push_back(new_ll);
+        delta += new_ll - level_loglike[q];
+    }
+    return delta;
+}
+
+void hierarchical_model::accept_loglike_delta(double delta) {
+    for (std::size_t i = 0; i < touched_levels.size(); ++i){
+        level_loglike[touched_levels[i]] = touched_loglike[i];
+    }
+    loglike += delta;
+    clear_touched_levels();
+}
+
+void hierarchical_model::clear_touched_levels() {
+    for (int q : touched_levels){
+        level_touched[q] = 0;
+    }
+    touched_levels.clear();
+}
+
+inline void hierarchical_model::log_undo(undo_op op, int idx, int group, int64_t value) {
+    undo_log.push_back({op, idx, group, value});
+}
+
+// Restores the state before the current proposal by replaying the undo log backwards
+template <typename state_t>
+void width_model<state_t>::undo_move() {
+    for (auto it = undo_log.rbegin(); it != undo_log.rend(); ++it){
+        switch (it->op){
+            case undo_op::nodes_in:
+                nodes_in.at(it->group, it->idx) = it->value;
+                break;
+            case undo_op::nodes_out:
+                nodes_out.at(it->group, it->idx) = it->value;
+                break;
+            case undo_op::group_size:
+                group_size[it->group] = it->value;
+                break;
+            case undo_op::state: {
+                state_t old_state = g[it->idx] ^ slot_bit<state_t>(it->group);
+                bit_groups.move(g[it->idx], old_state);
+                g[it->idx] = old_state;
+                break;
+            }
+            case undo_op::hcg_edges:
+                hcg_edges[it->group] = it->value;
+                break;
+            case undo_op::hcg_pairs:
+                hcg_pairs[it->group] = it->value;
+                break;
+            case undo_op::insert_group:
+                place_group(it->group, it->idx);
+                break;
+            case undo_op::remove_group:
+                remove_group(it->group);
+                break;
+        }
+    }
+    undo_log.clear();
+}
+
+template <typename state_t>
+void width_model<state_t>::update_bit(state_t& state, uint64_t bit, std::size_t group){
 
-    uint64_t group_mask = (1UL<<num_groups)-1;
-    uint64_t idxr = ~(1UL<<group)&group_mask;
-    uint64_t mask = state & idxr;
-    state = (mask | (bit<<group))&group_mask;
+    int slot = group_slot[group];
+    if (bit){
+        state |= slot_bit<state_t>(slot);
+    }else{
+        state &= ~slot_bit<state_t>(slot);
+    }
+
+}
 
+// Only the occupied part of each node list is saved; the order of the lists matters
+// because moves pick nodes from them by index. The per-level likelihood terms and the
+// state histogram follow from the counts and are rebuilt on loading, but the running
+// likelihood is kept as is, since recomputing it could change its last bits.
+template <typename state_t>
+void width_model<state_t>::save_state(std::ostream &out) {
+    write_value(out, static_cast<int32_t>(num_groups));
+    write_value(out, static_cast<int32_t>(num_slots));
+    write_vector(out, g);
+    write_vector(out, group_slot);
+    write_vector(out, group_size);
+    write_vector(out, hcg_edges);
+    write_vector(out, hcg_pairs);
+    std::vector<int> row;
+    for (int s = 0; s < num_slots; ++s){
+        row.clear();
+        for (int i = 0; i < group_size[s]; ++i){
+            row.push_back(nodes_in.at(s, i));
+        }
+        for (int i = 0; i < G.nvertices - group_size[s]; ++i){
+            row.push_back(nodes_out.at(s, i));
+        }
+        write_vector(out, row);
+    }
+    write_value(out, loglike);
+    write_value(out, beta);
+    write_rng(out, rng);
+}
+
+template <typename state_t>
+bool width_model<state_t>::load_state(std::istream &in) {
+    int32_t groups, slots;
+    if (!read_value(in, groups) || !read_value(in, slots) || slots != num_slots){
+        return false;
+    }
+    num_groups = groups;
+    if (!read_vector(in, g) || g.size() != static_cast<std::size_t>(G.nvertices)
+        || !read_vector(in, group_slot) || group_slot.size() != static_cast<std::size_t>(num_groups)
+        || !read_vector(in, group_size) || group_size.size() != static_cast<std::size_t>(num_slots)
+        || !read_vector(in, hcg_edges) || hcg_edges.size() != static_cast<std::size_t>(num_slots)
+        || !read_vector(in, hcg_pairs) || hcg_pairs.size() != static_cast<std::size_t>(num_slots)){
+        return false;
+    }
+    std::vector<int> row;
+    for (int s = 0; s < num_slots; ++s){
+        if (!read_vector(in, row) || row.size() != static_cast<std::size_t>(G.nvertices)
+            || group_size[s] < 0 || group_size[s] > G.nvertices){
+            return false;
+        }
+        for (int i = 0; i < group_size[s]; ++i){
+            nodes_in.at(s, i) = row[i];
+        }
+        for (int i = 0; i < G.nvertices - group_size[s]; ++i){
+            nodes_out.at(s, i) = row[group_size[s] + i];
+        }
+    }
+    if (!read_value(in, loglike) || !read_value(in, beta) || !read_rng(in, rng)){
+        return false;
+    }
+    set_bit_groups();
+    set_level_loglike();
+    if (neighbour_histograms){
+        neighbour_states.build(G, g);
+    }
+    return true;
 }
 
-void hierarchical_model::uniform_group_size(uint64_t& old_state, int& rand_node, int& rand_group, int& rand_idx){
+template <typename state_t>
+void width_model<state_t>::uniform_group_size(state_t& old_state, int& rand_node, int& rand_group, int& rand_idx){
 
     std::size_t num_nodes = G.nvertices;
     double p_type2 = 1.0/(2*num_groups*(num_nodes+1));
@@ -266,23 +848,8 @@ void hierarchical_model::uniform_group_size(uint64_t& old_state, int& rand_node,
 
             rand_group = gsl_rng_uniform_int(rng, num_groups) + 1;
 
-            nodes_in.insert_at(std::vector<int>(G.nvertices, -1), rand_group);
-            nodes_out.insert_at(std::vector<int>(G.nvertices, -1), rand_group);
-
-            for (int i = 0; i < num_nodes; ++i) {
-                nodes_out.at(i, rand_group) = i;
-            }
-
-            group_size.insert(group_size.begin() + rand_group, 0);
-            hcg_edges.insert(hcg_edges.begin() + rand_group, 0);
-            hcg_pairs.insert(hcg_pairs.begin() + rand_group, 0);
-
-            for (int u = 0; u < G.nvertices; ++u) {
-                g[u] = insert_zero_at(g[u], rand_group);
-            }
-
-            num_groups++;
-            added_group = true;
+            log_undo(undo_op::remove_group, 0, rand_group, 0);
+            insert_group(rand_group);
         }
     }else{
         if (num_groups == 1){
@@ -295,154 +862,282 @@ void hierarchical_model::uniform_group_size(uint64_t& old_state, int& rand_node,
         }
 
         rand_group = gsl_rng_uniform_int(rng,num_groups-1)+1;
+        int slot = group_slot[rand_group];
 
-        std::size_t n_out = G.nvertices - group_size[rand_group];
+        std::size_t n_out = G.nvertices - group_size[slot];
 
         if(gsl_rng_uniform(rng) < 0.5){
             // remove a node from the group
-            if(group_size[rand_group] == 0) {
+            if(group_size[slot] == 0) {
                 // remove group entirely!
                 rand_idx = -2;
                 rand_node = -2;
 
-                for(int u = 0; u < G.nvertices; ++u){
-                    g[u] = remove_bit_at(g[u], rand_group);
-                }
-
                 old_state = 0;
 
-                nodes_in.remove_at(rand_group);
-                nodes_out.remove_at(rand_group);
-
-                hcg_edges.erase(hcg_edges.begin()+rand_group);
-                hcg_pairs.erase(hcg_pairs.begin()+rand_group);
-                group_size.erase(group_size.begin()+rand_group);
-                num_groups--;
-                removed_group = true;
+                log_undo(undo_op::insert_group, group_slot[rand_group], rand_group, 0);
+                remove_group(rand_group);
                 return;
             }else{
                 // chose a node from the group at random and remove it
-                rand_idx = gsl_rng_uniform_int(rng,group_size[rand_group]);
-                rand_node = nodes_in.at(rand_idx, rand_group);
-                nodes_in.at(rand_idx, rand_group) = nodes_in.at(group_size[rand_group]-1, rand_group);
-                nodes_out.at(n_out, rand_group) = rand_node;
+                rand_idx = gsl_rng_uniform_int(rng,group_size[slot]);
+                rand_node = nodes_in.at(slot, rand_idx);
                 old_state = g[rand_node];
-                g[rand_node]-=(1UL<<rand_group);
-                group_size[rand_group]--;
-                removed_node = true;
+
+                log_undo(undo_op::nodes_in, rand_idx, slot, rand_node);
+                log_undo(undo_op::nodes_out, n_out, slot, nodes_out.at(slot, n_out));
+                log_undo(undo_op::state, rand_node, slot, 0);
+                log_undo(undo_op::group_size, 0, slot, group_size[slot]);
+
+                nodes_in.at(slot, rand_idx) = nodes_in.at(slot, group_size[slot]-1);
+                nodes_out.at(slot, n_out) = rand_node;
+                g[rand_node] &= ~slot_bit<state_t>(slot);
+                group_size[slot]--;
                 return;
             }
         }else{
             // add a node to the group
-            if(group_size[rand_group] == G.nvertices){
+            if(group_size[slot] == G.nvertices){
                 rand_node = -1;
                 rand_idx = -1;
                 old_state = 0;
                 return;
             }else{
                 rand_idx = gsl_rng_uniform_int(rng,n_out);
-                rand_node = nodes_out.at(rand_idx, rand_group);
-                nodes_out.at(rand_idx, rand_group) = nodes_out.at(n_out-1, rand_group);
-                nodes_in.at(group_size[rand_group], rand_group) = rand_node;
+                rand_node = nodes_out.at(slot, rand_idx);
                 old_state = g[rand_node];
-                g[rand_node]+=(1UL<<rand_group);
-                group_size[rand_group]++;
+
+                log_undo(undo_op::nodes_out, rand_idx, slot, rand_node);
+                log_undo(undo_op::nodes_in, group_size[slot], slot, nodes_in.at(slot, group_size[slot]));
+                log_undo(undo_op::state, rand_node, slot, 0);
+                log_undo(undo_op::group_size, 0, slot, group_size[slot]);
+
+                nodes_out.at(slot, rand_idx) = nodes_out.at(slot, n_out-1);
+                nodes_in.at(slot, group_size[slot]) = rand_node;
+                g[rand_node] |= slot_bit<state_t>(slot);
+                group_size[slot]++;
             }
         }
     }
 }
 
-void hierarchical_model::get_groups() {
+// Flips one slot of u and accepts the change, for moves that always move
+template <typename state_t>
+void width_model<state_t>::flip_slot(int u, int slot) {
+    state_t old_state = g[u];
+    g[u] ^= slot_bit<state_t>(slot);
+    update_hcg_props(u, old_state, slot);
+    accept_loglike_delta(calc_loglike_delta());
+    undo_log.clear();
+}
 
-    double new_loglike;
-    uint64_t old_state;
-    std::vector<long long> old_hcg_edges(num_groups, 0);
-    std::vector<long long> old_hcg_pairs(num_groups, 0);
-    for(int q = 0; q < num_groups; ++q){
-        old_hcg_edges[q] = hcg_edges[q];
-        old_hcg_pairs[q] = hcg_pairs[q];
+// Moves u between the in and out lists of every slot where its state changed, as
+// uniform_group_size does for one slot, after finding u in the list it leaves
+template <typename state_t>
+void width_model<state_t>::move_node_lists(int u, const state_t& old_state, const state_t& new_state){
+    for (int r = 1; r < num_groups; ++r){
+        int slot = group_slot[r];
+        bool was_in = has_slot(old_state, slot);
+        if (was_in == has_slot(new_state, slot)){
+            continue;
+        }
+        int n_out = G.nvertices - group_size[slot];
+        int idx = 0;
+        if (was_in){
+            while (nodes_in.at(slot, idx) != u){
+                idx++;
+            }
+            nodes_in.at(slot, idx) = nodes_in.at(slot, group_size[slot]-1);
+            nodes_out.at(slot, n_out) = u;
+            group_size[slot]--;
+        }else{
+            while (nodes_out.at(slot, idx) != u){
+                idx++;
+            }
+            nodes_out.at(slot, idx) = nodes_out.at(slot, n_out-1);
+            nodes_in.at(slot, group_size[slot]) = u;
+            group_size[slot]++;
+        }
     }
+}
 
-    int rand_node;
-    int rand_group;
-    int rand_idx;
-    uniform_group_size(old_state, rand_node, rand_group, rand_idx);
-    if (rand_node == -1){
-        new_loglike = loglike;
+// Draws a node and samples all its groups but group 0 from their exact conditional
+// distribution. uniform_group_size proposes a node for a group uniformly from the nodes
+// in or out of it, which without a Hastings correction samples group memberships with a
+// prior proportional to 1/C(N, group size); the conditional weighs each state of the
+// node by that prior as well as by the likelihood at the chain's temperature.
+//
+// With up to gibbs_max_groups groups every one of the 2^(groups-1) states is weighed:
+// they are visited in Gray code order, one flipped slot apart, so each costs a single
+// update_hcg_props, and the node then moves to the state drawn. With more groups the
+// node's groups are instead drawn one at a time from their conditional given the rest.
+// Returns whether the node's groups changed.
+template <typename state_t>
+bool width_model<state_t>::gibbs_move() {
+    int active = num_groups - 1;
+    if (active == 0){
+        return false;
+    }
+    int u = gsl_rng_uniform_int(rng, G.nvertices);
+    state_t old_state = g[u];
+
+    double prior = 0.0;
+    for (int r = 1; r < num_groups; ++r){
+        int slot = group_slot[r];
+        long long others = group_size[slot] - has_slot(old_state, slot);
+        join_weight[r] = std::log(static_cast<double>(others+1)) - std::log(static_cast<double>(G.nvertices-others));
+        if (has_slot(old_state, slot)){
+            prior += join_weight[r];
+        }
+    }
+
+    if (num_groups <= gibbs_max_groups){
+        std::size_t num_states = 1UL<<active;
+        gibbs_weights.resize(num_states);
+        gibbs_weights[0] = beta*loglike + prior;
+        double max_weight = gibbs_weights[0];
+        for (std::size_t i = 1; i < num_states; ++i){
+            int r = 1 + __builtin_ctzll(i);
+            int slot = group_slot[r];
+            prior += has_slot(g[u], slot) ? -join_weight[r] : join_weight[r];
+            flip_slot(u, slot);
+            gibbs_weights[i] = beta*loglike + prior;
+            max_weight = std::max(max_weight, gibbs_weights[i]);
+        }
 
+        double total = 0.0;
+        for (double &weight : gibbs_weights){
+            weight = std::exp(weight - max_weight);
+            total += weight;
+        }
+        double draw = gsl_rng_uniform(rng)*total;
+        std::size_t chosen = 0;
+        while (chosen+1 < num_states && draw >= gibbs_weights[chosen]){
+            draw -= gibbs_weights[chosen];
+            chosen++;
+        }
+
+        // the walk ended at the last Gray code; flip the slots where it differs from the one drawn
+        std::size_t last = num_states-1;
+        for (std::size_t diff = (last^(last>>1))^(chosen^(chosen>>1)); diff != 0; diff &= diff-1){
+            flip_slot(u, group_slot[1 + __builtin_ctzll(diff)]);
+        }
     }else{
-        if (rand_node == -2){
-            new_loglike = loglike;
-        }else{
-            update_hcg_props(rand_node, old_state);
-            new_loglike = calc_loglike();
-        }
-        if(gsl_rng_uniform(rng) < exp(new_loglike - loglike)){
-            loglike = new_loglike;
-            removed_node = false;
-            removed_group = false;
-            added_group = false;
-        }else{
-            if(removed_node){
-                group_size[rand_group]++;
-                int n_out = G.nvertices - group_size[rand_group];
-                nodes_out.at(n_out, rand_group) = -1;
-                nodes_in.at(rand_idx, rand_group) = rand_node;
-                g[rand_node]+=(1UL<<rand_group);
-                for(int q = 0; q < num_groups; ++q) {
-                    hcg_edges[q] = old_hcg_edges[q];
-                    hcg_pairs[q] = old_hcg_pairs[q];
-                }
-                removed_node = false;
-            }else if(removed_group){
-                nodes_in.insert_at(std::vector<int>(G.nvertices, -1), rand_group);
-                nodes_out.insert_at(std::vector<int>(G.nvertices, -1), rand_group);
+        for (int r = 1; r < num_groups; ++r){
+            int slot = group_slot[r];
+            double gain = has_slot(g[u], slot) ? -join_weight[r] : join_weight[r];
+            state_t before = g[u];
+            log_undo(undo_op::state, u, slot, 0);
+            g[u] ^= slot_bit<state_t>(slot);
+            update_hcg_props(u, before, slot);
+            double delta_loglike = calc_loglike_delta();
+            if (gsl_rng_uniform(rng) < 1.0/(1.0 + std::exp(-(beta*delta_loglike + gain)))){
+                accept_loglike_delta(delta_loglike);
+                undo_log.clear();
+            }else{
+                clear_touched_levels();
+                undo_move();
+            }
+        }
+    }
 
-                for (int u = 0; u < G.nvertices; ++u){
-                    nodes_out.at(u, rand_group) = u;
-                }
-                for (int u = 0; u < G.nvertices; ++u){
-                    g[u] = insert_zero_at(g[u], rand_group);
-                }
-                num_groups++;
-                group_size.insert(group_size.begin()+rand_group, 0);
-                hcg_edges.insert(hcg_edges.begin()+rand_group, 0);
-                hcg_pairs.insert(hcg_pairs.begin()+rand_group, 0);
-                for(int q = 0; q < num_groups; ++q) {
-                    hcg_edges[q] = old_hcg_edges[q];
-                    hcg_pairs[q] = old_hcg_pairs[q];
-                }
-                removed_group=false;
-            }else if (added_group){
-                nodes_in.remove_at(rand_group);
-                nodes_out.remove_at(rand_group);
-                group_size.erase(group_size.begin()+rand_group);
-                for (int u = 0; u < G.nvertices; ++u){
-                    g[u] = remove_bit_at(g[u], rand_group);
-                }
-                hcg_edges.erase(hcg_edges.begin()+rand_group);
-                hcg_pairs.erase(hcg_pairs.begin()+rand_group);
-                num_groups--;
-                for(int q = 0; q < num_groups; ++q) {
-                    hcg_edges[q] = old_hcg_edges[q];
-                    hcg_pairs[q] = old_hcg_pairs[q];
-                }
-                added_group = false;
+    move_node_lists(u, old_state, g[u]);
+    if (neighbour_histograms){
+        neighbour_states.move(u, old_state, g[u]);
+    }
+    return g[u] != old_state;
+}
+
+// Goes through the nodes once, flipping each of a node's groups but group 0 when that
+// raises the log-likelihood. The flips are proposed and undone like the moves of
+// get_groups, and only a gain above rounding noise is taken, so repeating the sweep
+// until it makes no flips ends in a local maximum.
+template <typename state_t>
+int width_model<state_t>::greedy_sweep() {
+    int flips = 0;
+    for (int u = 0; u < G.nvertices; ++u){
+        state_t old_state = g[u];
+        for (int r = 1; r < num_groups; ++r){
+            int slot = group_slot[r];
+            state_t before = g[u];
+            undo_log.clear();
+            log_undo(undo_op::state, u, slot, 0);
+            g[u] ^= slot_bit<state_t>(slot);
+            update_hcg_props(u, before, slot);
+            double delta_loglike = calc_loglike_delta();
+            if (delta_loglike > 1e-9){
+                accept_loglike_delta(delta_loglike);
+                flips++;
             }else{
-                // node added to a group
-                group_size[rand_group]--;
-                nodes_in.at(group_size[rand_group], rand_group) = -1;
-                nodes_out.at(rand_idx, rand_group) = rand_node;
-                g[rand_node]-=(1UL<<rand_group);
-                for(int q = 0; q < num_groups; ++q) {
-                    hcg_edges[q] = old_hcg_edges[q];
-                    hcg_pairs[q] = old_hcg_pairs[q];
-                }
+                clear_touched_levels();
+                undo_move();
             }
         }
+        move_node_lists(u, old_state, g[u]);
+        if (neighbour_histograms){
+            neighbour_states.move(u, old_state, g[u]);
+        }
     }
+    undo_log.clear();
+    return flips;
 }
 
+template <typename state_t>
+void width_model<state_t>::get_groups() {
+    phase_clock clock;
 
+    if (gibbs_fraction > 0.0 && gsl_rng_uniform(rng) < gibbs_fraction){
+        undo_log.clear();
+        stats.count(move_kind::heat_bath, gibbs_move());
+        clock.lap(stats, move_phase::heat_bath);
+        return;
+    }
+
+    double delta_loglike;
+    state_t old_state;
+    int rand_node;
+    int rand_group;
+    int rand_idx;
 
+    undo_log.clear();
+    uniform_group_size(old_state, rand_node, rand_group, rand_idx);
+    clock.lap(stats, move_phase::propose);
+    if (rand_node == -1){
+        stats.count(move_kind::no_op, false);
+        return;
+    }
+
+    move_kind kind;
+    if (rand_node == -2){
+        // an added group logs its removal to undo it, and a removed one its insertion
+        kind = (undo_log.back().op == undo_op::remove_group) ? move_kind::group_add : move_kind::group_remove;
+        // adding or removing an empty group leaves every count unchanged
+        delta_loglike = 0.0;
+    }else{
+        kind = has_slot(g[rand_node], group_slot[rand_group]) ? move_kind::node_add : move_kind::node_remove;
+        update_hcg_props(rand_node, old_state, group_slot[rand_group]);
+        clock.lap(stats, move_phase::update_hcg_props);
+        delta_loglike = calc_loglike_delta();
+        clock.lap(stats, move_phase::calc_loglike);
+    }
+    bool accepted = gsl_rng_uniform(rng) < exp(beta*delta_loglike);
+    if (accepted){
+        accept_loglike_delta(delta_loglike);
+        if (neighbour_histograms && rand_node >= 0){
+            neighbour_states.move(rand_node, old_state, g[rand_node]);
+        }
+    }else{
+        clear_touched_levels();
+        undo_move();
+    }
+    stats.count(kind, accepted);
+    clock.lap(stats, move_phase::accept_reject);
+}
 
+template class width_model<uint8_t>;
+template class width_model<uint16_t>;
+template class width_model<uint32_t>;
+template class width_model<uint64_t>;
+template class width_model<wide_state<2>>;
+template class width_model<wide_state<4>>;
+template class width_model<wide_state<8>>;
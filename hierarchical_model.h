@@ -8,43 +8,104 @@
 #include "parameters.h"
 #include <iostream>
 #include <array>
+#include <memory>
 #include <gsl/gsl_rng.h>
-#include "indexed_list.h"
+#include "mvector.h"
 #include "readgml.h"
+#include "log_factorial.h"
+#include "group_state.h"
+#include "hcg_kernels.h"
+#include "state_histogram.h"
+#include "neighbour_histogram.h"
+#include "sampler_stats.h"
+
+// Kinds of edits recorded in the undo log while a move is proposed
+enum class undo_op {
+    nodes_in,     // nodes_in.at(group, idx) held value
+    nodes_out,    // nodes_out.at(group, idx) held value
+    group_size,   // group_size[group] held value
+    state,        // the bit of slot group was flipped in g[idx]
+    hcg_edges,    // hcg_edges[group] held value
+    hcg_pairs,    // hcg_pairs[group] held value
+    insert_group, // an empty group was removed from slot idx at position group
+    remove_group  // an empty group was inserted at position group
+};
+
+struct undo_record {
+    undo_op op;
+    int idx;
+    int group;
+    int64_t value;
+};
 
+// The parts of the model that do not depend on how wide a group state is: the groups'
+// slots, the counts and likelihood terms indexed by slot, and the undo log. The states
+// themselves and the moves that edit them live in width_model.
 class hierarchical_model {
     public:
+
         int num_groups;
         int max_num_groups;
-
-        NETWORK G; // struct storing the network
-        std::vector<uint64_t> g; // group assignments
-        indexed_list nodes_in;
-        indexed_list nodes_out;
+        int num_slots; // group slots available in a state
+
+        const NETWORK &G; // network, shared read-only between chains
+        std::vector<int> group_slot; // slot of each group, in hierarchy order
+        std::vector<int> slot_remap; // scratch space for respread_slots
+        mvector nodes_in; // nodes in each slot's group, indexed (slot, idx)
+        mvector nodes_out; // nodes outside each slot's group, indexed (slot, idx)
+        // the per-group values below are indexed by slot
         std::vector<long long> group_size;
         std::vector<long long> hcg_edges; // edges in each group
         std::vector<long long> hcg_pairs; // viable pairs in each group
-        std::vector<double> log_fact = std::vector<double>(270000000, 0);
-        std::unordered_map<uint64_t, std::size_t> bit_groups;
+        std::vector<double> level_loglike; // likelihood contribution of each group
+        std::vector<char> level_touched; // flags groups whose counts changed in the current move
+        std::vector<int> touched_levels; // groups whose counts changed in the current move
+        std::vector<double> touched_loglike; // proposed contribution of each group in touched_levels
+        std::vector<long long> pair_moves; // pairs moving to or from each level in the current move
+        std::vector<long long> edge_moves; // edges moving to or from each level in the current move
+        log_factorial log_fact; // ln(n!) for the likelihood
+        std::vector<undo_record> undo_log; // edits made by the current proposal, replayed in reverse on rejection
         gsl_rng *rng;
         double loglike;
-        bool removed_group = false;
-        bool removed_node = false;
-        bool added_group = false;
-
-        hierarchical_model(parameters params);
-
-        inline std::size_t hcg(int u, int v);
-        inline std::size_t hcg_node(const uint64_t& old_state, int u);
-        inline uint64_t insert_zero_at(uint64_t val, std::size_t pos);
-        inline uint64_t remove_bit_at(uint64_t val, std::size_t pos);
-
-        void partition();
-
-        void set_hcg_edges();
-        void set_hcg_pairs();
-        std::vector<std::vector<int>> get_group_matrix();
-        void set_nodes_in_out();
+        double beta = 1.0; // inverse temperature the likelihood is raised to, 1 samples the posterior
+        double gibbs_fraction; // share of steps that are heat-bath moves of a whole node
+        int gibbs_max_groups; // up to this many groups a heat-bath move weighs every state of the node
+        std::vector<double> join_weight; // log prior gain of the node of a heat-bath move joining each group
+        std::vector<double> gibbs_weights; // log weight of each state a heat-bath move weighs
+        int setup_threads; // threads the edges and pairs in each group are first counted on
+        sampler_stats stats; // moves proposed and accepted by kind, and time per phase with HCP_TIMERS
+
+        hierarchical_model(const parameters &params, const NETWORK &network, unsigned long seed, int num_slots);
+        virtual ~hierarchical_model();
+        hierarchical_model(const hierarchical_model&) = delete;
+        hierarchical_model& operator=(const hierarchical_model&) = delete;
+
+        // proposes one move and accepts or rejects it
+        virtual void get_groups() = 0;
+        // flips every group of every node that raises the log-likelihood, returning the flips made
+        virtual int greedy_sweep() = 0;
+
+        int insert_group(int r);
+        void place_group(int r, int slot);
+        int remove_group(int r);
+        void remove_empty_groups();
+        virtual void respread_slots(int hole) = 0;
+        void move_slot(int from, int to);
+
+        // copies of the state in hierarchy order, as written to the output files: every
+        // node takes group_words() words, holding group r in bit r%64 of word r/64
+        int group_words() const { return (num_groups+63)/64; }
+        std::vector<uint64_t> get_g();
+        virtual void get_g(std::vector<uint64_t>& groups) = 0;
+        virtual std::vector<std::vector<int>> get_group_matrix() = 0;
+        // replaces the state by the groups given, groups_count of them laid out as get_g writes them
+        virtual void set_groups(const std::vector<uint64_t>& groups, int groups_count) = 0;
+        void spread_group_slots();
+        std::vector<long long> by_group(const std::vector<long long>& by_slot);
+        void by_group(const std::vector<long long>& by_slot, std::vector<long long>& values);
+        std::vector<long long> get_hcg_edges();
+        std::vector<long long> get_hcg_pairs();
+        std::vector<long long> get_group_size();
 
 
         void print_hcg_pairs();
@@ -52,18 +113,95 @@ class hierarchical_model {
         void print_group_size();
         void print_g();
 
-        void update_hcg_props(int u, const uint64_t& old_state);
+        double calc_loglike();
+        inline double calc_level_loglike(int q);
+        void set_level_loglike();
+        inline void touch_level(int q);
+        double calc_loglike_delta();
+        void accept_loglike_delta(double delta);
+        void clear_touched_levels();
+        inline void log_undo(undo_op op, int idx, int group, int64_t value);
+
+        // the sampler state needed to continue the chain exactly, for checkpoints
+        virtual void save_state(std::ostream &out) = 0;
+        virtual bool load_state(std::istream &in) = 0;
+
+        // turns the per-node histograms of neighbour states on or off, and the bytes they take
+        virtual void use_neighbour_histograms(bool enabled) = 0;
+        virtual std::size_t neighbour_histogram_bytes() const = 0;
 
-        double ln_fact(int arg);
+};
 
-        double calc_loglike();
-        void update_bit(uint64_t& state, uint64_t bit, std::size_t group);
+// The model with every node's groups held in a state_t, one bit per slot: an unsigned
+// integer up to 64 slots and a wide_state beyond. The sampler and the hcg kernels are
+// compiled for each width, so a run whose max_num_groups fits in a narrower state keeps
+// smaller states and node lists. make_model picks the width.
+template <typename state_t>
+class width_model : public hierarchical_model {
+    public:
+        std::vector<state_t> g; // group assignments, one bit per slot
+        state_histogram<state_t> bit_groups; // number of nodes holding each distinct group state
+        flip_kernel<state_t> flip_levels; // fastest kernel the CPU supports
+
+        // Optionally the histogram of every node's neighbour states, so the edges of a move
+        // are counted over u's distinct neighbour states and the edge levels of any
+        // candidate state of u are found without reading the adjacency. In return every
+        // accepted move updates the histograms of u's neighbours.
+        bool neighbour_histograms = false;
+        neighbour_histogram<state_t> neighbour_states;
+
+        width_model(const parameters &params, const NETWORK &network, unsigned long seed);
+
+        inline std::size_t hcg(int u, int v);
+        state_t to_slots(uint64_t groups);
+        state_t from_groups(const uint64_t *groups);
+        void to_groups(const state_t &state, uint64_t *groups);
 
+        void partition();
 
-        void uniform_group_size(uint64_t& old_state, int& rand_node, int& rand_group, int& rand_idx);
-        void get_groups();
+        void set_hcg_edges();
+        void set_hcg_pairs();
+        void set_hcg_pairs_by_states();
+        void set_hcg_pairs_by_subsets();
+        std::vector<std::vector<int>> get_group_matrix() override;
+        void set_nodes_in_out();
+        void set_bit_groups();
+        void set_counts();
+        void respread_slots(int hole) override;
+
+        void get_g(std::vector<uint64_t>& groups) override;
+        using hierarchical_model::get_g;
+        void set_groups(const std::vector<uint64_t>& groups, int groups_count) override;
+
+        void update_hcg_props(int u, const state_t& old_state, int slot);
+        void flip_slot(int u, int slot);
+        void move_node_lists(int u, const state_t& old_state, const state_t& new_state);
+        void edge_levels(int u, const state_t& state, long long *levels);
+        void use_neighbour_histograms(bool enabled) override;
+        std::size_t neighbour_histogram_bytes() const override;
+        void undo_move();
+        void update_bit(state_t& state, uint64_t bit, std::size_t group);
+
+        void save_state(std::ostream &out) override;
+        bool load_state(std::istream &in) override;
+
+        void uniform_group_size(state_t& old_state, int& rand_node, int& rand_group, int& rand_idx);
+        bool gibbs_move();
+        void get_groups() override;
+        int greedy_sweep() override;
 
 };
 
+// The model in the narrowest integer state that leaves every group of a run with
+// max_num_groups groups a spare slot next to it, so that inserting groups rarely
+// respreads the slots. Beyond 64 groups it is the narrowest wide state that holds them
+// all (128, 256 or 512 slots), which keeps the words searched per hcg few.
+std::unique_ptr<hierarchical_model> make_width_model(const parameters &params, const NETWORK &network,
+                                                     unsigned long seed);
+
+// The model started as init_strategy asks: make_width_model's random or given groups,
+// refined from a coarsened network with init_strategy: multilevel.
+std::unique_ptr<hierarchical_model> make_model(const parameters &params, const NETWORK &network, unsigned long seed);
+
 
 #endif //HCP_HIERARCHICAL_MODEL_H
@@ -0,0 +1,93 @@
+//
+// Compares the random and the multilevel start. The network is read from a parameters
+// file as hcp does, and a chain is run from each start with the same seed, recording
+// the log-likelihood every interval iterations. A chain's plateau is the mean
+// log-likelihood over the last quarter of its run; the best plateau of the two is the
+// reference, and each start is reported with the time its model took to set up and the
+// first iteration at which its log-likelihood came within the tolerance of the
+// reference, twice the standard deviation over that last quarter (and at least 1).
+//
+// usage: hcp_init_bench <parameters file> [iterations] [interval]
+//
+
+#include "hierarchical_model.h"
+#include "graph_formats.h"
+#include "multilevel_init.h"
+#include "parameters.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 4){
+        std::cerr<<"usage: "<<argv[0]<<" <parameters file> [iterations] [interval]"<<std::endl;
+        return EXIT_FAILURE;
+    }
+    parameters params(argv[1]);
+    if (params.get_error_status() == 1){
+        return EXIT_FAILURE;
+    }
+    long iterations = (argc > 2) ? std::stol(argv[2]) : 10000000;
+    long interval = (argc > 3) ? std::stol(argv[3]) : 10000;
+
+    NETWORK network;
+    read_graph(&network, params.get_graph_path(), params.get_graph_format(), params.get_remap_node_ids(),
+               params.get_read_threads());
+
+    const char *names[] = {"random", "multilevel"};
+    std::vector<double> setup(2);
+    std::vector<double> tolerance(2);
+    std::vector<double> plateau(2);
+    std::vector<std::vector<double>> traces(2);
+    for (int s = 0; s < 2; ++s){
+        auto start = std::chrono::steady_clock::now();
+        std::unique_ptr<hierarchical_model> model = make_width_model(params, network, params.get_seed());
+        if (s == 1){
+            multilevel_start(*model, params, params.get_seed());
+        }
+        setup[s] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        traces[s].push_back(model->loglike);
+        for (long itr = 1; itr <= iterations; ++itr){
+            model->get_groups();
+            if (itr%interval == 0){
+                traces[s].push_back(model->loglike);
+            }
+        }
+
+        std::size_t tail = traces[s].size() - std::max<std::size_t>(1, traces[s].size()/4);
+        double sum = 0.0;
+        double sum_sq = 0.0;
+        for (std::size_t i = tail; i < traces[s].size(); ++i){
+            sum += traces[s][i];
+            sum_sq += traces[s][i]*traces[s][i];
+        }
+        std::size_t count = traces[s].size() - tail;
+        plateau[s] = sum/count;
+        tolerance[s] = std::max(2.0*std::sqrt(std::max(0.0, sum_sq/count - plateau[s]*plateau[s])), 1.0);
+    }
+
+    double reference = std::max(plateau[0], plateau[1]);
+    std::cout<<"start\tsetup s\tplateau\titerations to plateau"<<std::endl;
+    for (int s = 0; s < 2; ++s){
+        long reached = -1;
+        for (std::size_t i = 0; i < traces[s].size(); ++i){
+            if (traces[s][i] >= reference - tolerance[s]){
+                reached = i*interval;
+                break;
+            }
+        }
+        std::cout<<names[s]<<"\t"<<setup[s]<<"\t"<<plateau[s]<<"\t";
+        if (reached < 0){
+            std::cout<<"not reached"<<std::endl;
+        }else{
+            std::cout<<reached<<std::endl;
+        }
+    }
+    free_network(&network);
+    return 0;
+}
@@ -0,0 +1,83 @@
+//
+// Checks that every flip_levels kernel the CPU can run gives the same levels and total as
+// the scalar kernel. For every integer state width and every slot k above 0 it draws
+// random states holding slot 0, dense and sparse, in arrays of every length up to past
+// two registers so the vector loops and their scalar tails are both run, with and
+// without weights. Any difference is printed and fails the test.
+//
+// usage: hcp_kernel_test [trials per slot]
+//
+
+#include "hcg_kernels.h"
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    template <typename state_t>
+    state_t random_state(std::mt19937_64 &gen, int density) {
+        // density 0 keeps every bit drawn, higher densities clear more of them
+        uint64_t bits = gen();
+        for (int d = 0; d < density; ++d){
+            bits &= gen();
+        }
+        return static_cast<state_t>(bits) | 1;
+    }
+
+    template <typename state_t>
+    int check_width(const std::string &name, int trials, std::mt19937_64 &gen) {
+        int bits = 8*sizeof(state_t);
+        std::vector<simd_level> kernels;
+        for (simd_level simd : {simd_level::avx2, simd_level::avx512}){
+            if (simd <= detect_simd()){
+                kernels.push_back(simd);
+            }
+        }
+        flip_kernel<state_t> scalar = get_flip_kernel<state_t>(simd_level::scalar);
+        int failures = 0;
+        long checks = 0;
+        for (int k = 1; k < bits; ++k){
+            for (int t = 0; t < trials; ++t){
+                int density = t%4;
+                std::size_t n = t%40;
+                std::vector<state_t> states(n);
+                std::vector<long long> weights(n);
+                for (std::size_t i = 0; i < n; ++i){
+                    states[i] = random_state<state_t>(gen, density);
+                    weights[i] = 1 + gen()%8;
+                }
+                state_t base = random_state<state_t>(gen, density) & ~slot_bit<state_t>(k);
+                for (bool weighted : {true, false}){
+                    const long long *w = weighted ? weights.data() : NULL;
+                    std::vector<long long> expected(bits, 0);
+                    long long expected_total = scalar(states.data(), w, n, base, k, expected.data());
+                    for (simd_level simd : kernels){
+                        std::vector<long long> level(bits, 0);
+                        long long total = get_flip_kernel<state_t>(simd)(states.data(), w, n, base, k, level.data());
+                        checks++;
+                        if (total != expected_total || level != expected){
+                            failures++;
+                            std::cout<<name<<" "<<simd_name(simd)<<": k "<<k<<", "<<n<<" states"
+                                     <<(weighted ? " with weights" : "")<<": "
+                                     <<((total != expected_total) ? "total " : "levels ")<<"differ from scalar"
+                                     <<std::endl;
+                        }
+                    }
+                }
+            }
+        }
+        std::cout<<name<<": "<<checks<<" comparisons with the scalar kernel, "<<failures<<" different"<<std::endl;
+        return failures;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int trials = (argc > 1) ? std::stoi(argv[1]) : 200;
+    std::cout<<"kernels up to "<<simd_name(detect_simd())<<std::endl;
+    std::mt19937_64 gen(1);
+    int failures = check_width<uint8_t>("8-bit", trials, gen) + check_width<uint16_t>("16-bit", trials, gen)
+                   + check_width<uint32_t>("32-bit", trials, gen) + check_width<uint64_t>("64-bit", trials, gen);
+    return failures ? EXIT_FAILURE : 0;
+}
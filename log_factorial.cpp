@@ -0,0 +1,26 @@
+//
+// Log-factorial provider used by the likelihood.
+//
+
+#include "log_factorial.h"
+
+log_factorial::log_factorial(std::size_t table_size)
+    : _table(table_size, 0) {
+    for (std::size_t i = 0; i < table_size; ++i){
+        _table[i] = lgamma(static_cast<double>(i)+1.0);
+    }
+}
+
+double log_factorial::stirling(long long n) const {
+    // ln(n!) = n ln n - n + ln(2 pi n)/2 + 1/(12n) - 1/(360n^3) + 1/(1260n^5) - ...
+    // the first omitted term is below 1e-24 once n is past the table
+    double x = static_cast<double>(n);
+    double inv = 1.0/x;
+    double inv2 = inv*inv;
+    double series = inv*(1.0/12.0 - inv2*(1.0/360.0 - inv2*(1.0/1260.0)));
+    return x*std::log(x) - x + 0.5*std::log(2.0*M_PI*x) + series;
+}
+
+std::size_t log_factorial::table_size() const {
+    return _table.size();
+}
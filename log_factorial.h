@@ -0,0 +1,36 @@
+//
+// Log-factorial provider used by the likelihood.
+//
+
+#ifndef HCP_LOG_FACTORIAL_H
+#define HCP_LOG_FACTORIAL_H
+
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+class log_factorial {
+
+    private:
+        std::vector<double> _table;
+
+        double stirling(long long n) const;
+
+    public:
+        // ln(n!) is tabulated for n < table_size and evaluated with Stirling's series above that;
+        // n must not be negative
+        explicit log_factorial(std::size_t table_size = 4096);
+
+        inline double operator()(long long n) const {
+            assert(n >= 0);
+            if (n < static_cast<long long>(_table.size())){
+                return _table[n];
+            }
+            return stirling(n);
+        }
+
+        std::size_t table_size() const;
+};
+
+
+#endif //HCP_LOG_FACTORIAL_H
@@ -5,12 +5,145 @@
 #include <iostream>
 #include "parameters.h"
 #include "hierarchical_model.h"
+#include "chain.h"
+#include "thread_pool.h"
+#include "replica_exchange.h"
+#include "checkpoint.h"
+#include "graph_cache.h"
+#include "graph_formats.h"
+#include "map_search.h"
 #include <chrono>
 #include <fstream>
+#include <iomanip>
 #include <ctime>
+#include <memory>
+
+// hcp convert [--format auto|gml|edgelist|mtx] [--no-remap] <graph> [cache]: parses a
+// network file once and saves it as a binary cache, by default next to the network file
+// where runs that read it the same way, as graph_format and remap_node_ids say, pick it
+// up automatically
+int convert_graph(int argc, char* argv[]) {
+    const char *usage = "usage: hcp convert [--format auto|gml|edgelist|mtx] [--no-remap] <graph> [output]";
+    graph_format format = graph_format::automatic;
+    bool remap_ids = true;
+    std::vector<std::string> paths;
+    for (int i = 2; i < argc; ++i){
+        std::string arg = argv[i];
+        if (arg == "--format" && i+1 < argc){
+            std::string value = argv[++i];
+            if (value == "auto") {
+                format = graph_format::automatic;
+            } else if (value == "gml") {
+                format = graph_format::gml;
+            } else if (value == "edgelist") {
+                format = graph_format::edge_list;
+            } else if (value == "mtx") {
+                format = graph_format::matrix_market;
+            } else {
+                std::cerr<<"unsupported graph format '"<<value<<"'"<<std::endl;
+                return EXIT_FAILURE;
+            }
+        }else if (arg == "--no-remap"){
+            remap_ids = false;
+        }else if (arg.rfind("--", 0) == 0 || paths.size() == 2){
+            std::cerr<<usage<<std::endl;
+            return EXIT_FAILURE;
+        }else{
+            paths.push_back(arg);
+        }
+    }
+    if (paths.empty()){
+        std::cerr<<usage<<std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string graph_path = paths[0];
+    std::string cache_path = (paths.size() > 1) ? paths[1] : graph_cache_path(graph_path);
+    graph_source source;
+    if (!stat_graph_source(graph_path, format, remap_ids, source)){
+        std::cerr<<"Unable to open '"<<graph_path<<"'"<<std::endl;
+        return EXIT_FAILURE;
+    }
+    NETWORK network;
+    if (parse_graph(&network, graph_path, source.format, source.remap_ids,
+                    std::max(1, static_cast<int>(std::thread::hardware_concurrency()))) != 0){
+        std::cerr<<"Unable to read '"<<graph_path<<"'; no graph cache written"<<std::endl;
+        return EXIT_FAILURE;
+    }
+    bool written = write_graph_cache(network, cache_path, source);
+    free_network(&network);
+    if (!written){
+        return EXIT_FAILURE;
+    }
+    std::cout<<"graph cache written to "<<cache_path<<std::endl;
+    return 0;
+}
+
+// mode: map runs an annealed search on every chain and writes the best state any of
+// them found to <saved_data_name>_map.txt: its log-likelihood, its number of groups and
+// the groups of every node, as in *_configs.txt
+int search_map(const parameters &params, const NETWORK &network) {
+    int n_chains = params.get_num_chains();
+    unsigned long seed = params.get_seed();
+    std::cout<<"searching for the most likely state with "<<n_chains<<" chain(s) on "<<params.get_num_threads()
+             <<" thread(s), seed "<<seed<<std::endl;
+    std::vector<std::unique_ptr<map_search>> searches;
+    for (int c = 0; c < n_chains; ++c){
+        searches.push_back(std::make_unique<map_search>(c, params, network, seed + c));
+    }
+
+    install_stop_handlers();
+    auto start = std::chrono::steady_clock::now();
+    {
+        thread_pool pool(params.get_num_threads());
+        for (auto &search : searches){
+            map_search *s = search.get();
+            pool.submit([s]{ s->run(); });
+        }
+        pool.wait();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout<<"-----------------------------------------------------"<<std::endl;
+    int best = 0;
+    for (int c = 0; c < n_chains; ++c){
+        const map_search &search = *searches[c];
+        std::cout<<"chain "<<c<<": best energy "<<search.best_loglike<<" at iteration "<<search.best_itr<<" of "
+                 <<search.itr<<", "<<search.model->loglike<<" after "<<search.greedy_sweeps<<" greedy sweep(s), groups "
+                 <<search.model->num_groups<<std::endl;
+        if (search.model->loglike > searches[best]->model->loglike){
+            best = c;
+        }
+    }
+    std::cout<<"searched in "<<seconds<<" s"<<std::endl;
+
+    hierarchical_model &model = *searches[best]->model;
+    std::filesystem::path path = params.get_save_dir()/(params.get_saved_data_name()+"_map.txt");
+    std::ofstream output(path);
+    output<<std::setprecision(17)<<model.loglike<<"\n"<<model.num_groups<<"\n";
+    std::vector<uint64_t> groups = model.get_g();
+    std::size_t words = model.group_words();
+    for (int u = 0; u < network.nvertices; ++u){
+        output<<decimal_groups(groups.data() + u*words, words)<<" ";
+    }
+    output<<"\n";
+    if (!output){
+        std::cerr<<"Unable to write '"<<path.string()<<"'"<<std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout<<"most likely state of chain "<<best<<" written to "<<path.string()<<std::endl;
+    return 0;
+}
 
 int main(int argc, char* argv[]) {
 
+    if (argc < 2){
+        std::cerr<<"usage: hcp <parameters file> | hcp convert <graph> [output]"<<std::endl;
+        return EXIT_FAILURE;
+    }
+    if (std::string(argv[1]) == "convert"){
+        return convert_graph(argc, argv);
+    }
+
     std::string config_file = argv[1];
     parameters params(config_file);
 
@@ -18,84 +151,219 @@ int main(int argc, char* argv[]) {
         return EXIT_FAILURE;
     }
 
+    // the network is read once and shared read-only by every chain
+    std::cout<<"reading in network"<<std::endl;
+    NETWORK network;
+    read_graph(&network, params.get_graph_path(), params.get_graph_format(), params.get_remap_node_ids(),
+               params.get_read_threads());
 
-    hierarchical_model hcp(params);
+    if (params.get_mode() == run_mode::map){
+        int status = search_map(params, network);
+        free_network(&network);
+        return status;
+    }
 
-    hcp.print_hcg_pairs();
-    std::cout<<std::endl;
-    hcp.print_hcg_edges();
-    std::cout<<std::endl;
+    int n_chains = params.get_num_chains();
+    unsigned long seed = params.get_seed();
+    int n_rungs = params.get_temperatures().size();
+    std::cout<<"running "<<n_chains<<" chain(s) of "<<n_rungs<<" temperature(s) on "<<params.get_num_threads()
+             <<" thread(s), seed "<<seed<<std::endl;
 
-    std::vector<std::vector<uint64_t>> intermediate_states;
-    std::vector<std::vector<long long>> hcg_edges;
-    std::vector<std::vector<long long>> hcg_pairs;
-    std::vector<std::vector<long long>> group_size;
-    std::vector<double> energies;
-    std::vector<std::size_t> num_groups;
+    // with a temperature ladder every chain is an ensemble of tempered replicas and only
+    // the replica at temperature 1 keeps samples
+    std::vector<std::unique_ptr<chain>> chains;
+    std::vector<std::unique_ptr<replica_exchange>> ensembles;
+    std::vector<sample_store*> samples;
+    for (int c = 0; c < n_chains; ++c){
+        // consecutive seeds give each chain and replica its own random number stream
+        if (n_rungs > 1){
+            ensembles.push_back(std::make_unique<replica_exchange>(c, params, network, seed + c*(n_rungs+1)));
+            samples.push_back(&ensembles.back()->samples);
+        }else{
+            chains.push_back(std::make_unique<chain>(c, params, network, seed + c));
+            samples.push_back(chains.back()->samples);
+        }
+    }
+    auto cold_model = [&](int c) -> hierarchical_model& {
+        return (n_rungs > 1) ? ensembles[c]->cold_model() : *chains[c]->model;
+    };
 
+    // every chain streams its samples to its own binary file on a background thread;
+    // a single chain keeps the original file names
+    std::string filename = params.get_saved_data_name();
+    auto chain_name = [&](int c) {
+        return (n_chains > 1) ? filename+"_chain"+std::to_string(c) : filename;
+    };
+    auto sample_path = [&](int c) {
+        return params.get_save_dir()/(chain_name(c)+"_samples.bin");
+    };
+
+    // with posterior_summary every chain also sums up the states it keeps as it goes, and
+    // writes the summary to <name>_summary.txt at the end
+    if (params.get_summary() != summary_level::none){
+        for (int c = 0; c < n_chains; ++c){
+            samples[c]->summary = std::make_unique<posterior_summary>(
+                network, params.get_max_num_groups(), params.get_summary() == summary_level::neighbours);
+        }
+    }
+
+    // a resumed run continues every chain from its checkpoint and appends to the sample
+    // files it had written
+    std::vector<uint64_t> sample_offsets(n_chains, 0);
+    if (!params.get_resume_from().empty()){
+        std::cout<<"resuming from "<<params.get_resume_from()<<std::endl;
+        if (!read_checkpoint(params.get_resume_from(), chains, ensembles, network.nvertices, sample_offsets)){
+            return EXIT_FAILURE;
+        }
+    }else{
+        // a new run gives every chain and replica the start init_strategy asks for, in parallel
+        thread_pool pool(params.get_num_threads());
+        auto start_chain = [&](chain *c) {
+            pool.submit([c, &params]{ c->start(params); });
+        };
+        for (auto &ch : chains){
+            start_chain(ch.get());
+        }
+        for (auto &ensemble : ensembles){
+            for (auto &replica : ensemble->replicas){
+                start_chain(replica.get());
+            }
+        }
+        pool.wait();
+    }
+    // sample_format: none keeps no sample files, leaving only the summaries
+    std::vector<std::unique_ptr<sample_writer>> writers(n_chains);
+    if (params.get_sample_file()){
+        for (int c = 0; c < n_chains; ++c){
+            writers[c] = std::make_unique<sample_writer>(sample_path(c), network.nvertices, params.get_max_num_groups(),
+                                                         sample_offsets[c]);
+            samples[c]->writer = writers[c].get();
+        }
+    }
 
+    // every stats_interval iterations each chain, and each replica, writes a line of
+    // statistics to <saved_data_name>_stats.jsonl
+    std::unique_ptr<stats_log> stats;
+    if (params.get_stats_interval() > 0){
+        std::filesystem::path stats_path = params.get_save_dir()/(filename+"_stats.jsonl");
+        stats = std::make_unique<stats_log>(stats_path, !params.get_resume_from().empty());
+        if (!stats->is_open()){
+            std::cerr<<"Unable to open '"<<stats_path.string()<<"'"<<std::endl;
+            return EXIT_FAILURE;
+        }
+        auto log_to = [&](chain &c) {
+            c.stats_out = stats.get();
+            c.stats_interval = params.get_stats_interval();
+        };
+        for (auto &ch : chains){
+            log_to(*ch);
+        }
+        for (auto &ensemble : ensembles){
+            for (auto &replica : ensemble->replicas){
+                log_to(*replica);
+            }
+        }
+    }
 
+    cold_model(0).print_hcg_pairs();
+    std::cout<<std::endl;
+    cold_model(0).print_hcg_edges();
+    std::cout<<std::endl;
 
     long num_itrs = params.get_max_itr();
-    for(long i = 0; i < num_itrs; ++i){
-        hcp.get_groups();
-        if((i>10000000) && (i%1500==0)){
-            intermediate_states.push_back(hcp.g);
-            hcg_edges.push_back(hcp.hcg_edges);
-            hcg_pairs.push_back(hcp.hcg_pairs);
-            group_size.push_back(hcp.group_size);
-            energies.push_back(hcp.loglike);
-            num_groups.push_back(hcp.num_groups);
-        }
-        if(i%10000000==0){
-            std::cout<<"-----------------------------------------------------"<<std::endl;
-            auto curr = std::chrono::system_clock::now();
-            auto tm = std::chrono::system_clock::to_time_t(curr);
-            std::cout<<"time: "<< std::put_time(std::localtime(&tm), "%c %Z")<<std::endl;
-            std::cout<<"iteration: "<<i<<" energy: "<<hcp.loglike<<std::endl;
-            hcp.print_hcg_pairs();
-            std::cout<<std::endl;
-            hcp.print_hcg_edges();
-            std::cout<<std::endl;
-            hcp.print_group_size();
-            std::cout<<std::endl;
+    auto position = [&]() {
+        long itr = num_itrs;
+        for (auto &ch : chains){
+            itr = std::min(itr, ch->itr);
+        }
+        for (auto &ensemble : ensembles){
+            itr = std::min(itr, ensemble->position());
+        }
+        return itr;
+    };
+    long start_itr = position();
+
+    // the run advances in pieces of checkpoint_interval iterations with a checkpoint after
+    // each; on SIGINT or SIGTERM the chains stop where they are and a last one is written
+    std::filesystem::path checkpoint_path = params.get_save_dir()/(filename+"_checkpoint.bin");
+    long interval = params.get_checkpoint_interval();
+    install_stop_handlers();
+    auto start = std::chrono::steady_clock::now();
+    {
+        thread_pool pool(params.get_num_threads());
+        while (position() < num_itrs && !stop_requested()){
+            long end = (interval > 0) ? std::min((position()/interval + 1)*interval, num_itrs) : num_itrs;
+            if (n_rungs > 1){
+                run_replica_exchange(ensembles, pool, end);
+            }else{
+                for (auto &ch : chains){
+                    chain *c = ch.get();
+                    pool.submit([c, end]{ c->run_steps(end); });
+                }
+                pool.wait();
+            }
+            if (stop_requested() || (interval > 0 && end < num_itrs)){
+                if (write_checkpoint(checkpoint_path, chains, ensembles, writers)){
+                    std::cout<<"checkpoint written to "<<checkpoint_path.string()<<" at iteration "<<position()<<std::endl;
+                }
+            }
         }
     }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (position() < num_itrs){
+        std::cout<<"stopped at iteration "<<position()<<"; set resume_from: "<<checkpoint_path.string()
+                 <<" to continue"<<std::endl;
+        for (auto &writer : writers){
+            if (writer){
+                writer->close();
+            }
+        }
+        ensembles.clear();
+        chains.clear();
+        free_network(&network);
+        return EXIT_FAILURE;
+    }
+
+    double total_steps = static_cast<double>(num_itrs - start_itr)*n_chains*n_rungs;
+    std::cout<<"-----------------------------------------------------"<<std::endl;
+    std::cout<<"throughput: "<<total_steps/seconds<<" steps/sec over "<<n_chains*n_rungs<<" chain(s) in "<<seconds<<" s"<<std::endl;
+    std::vector<std::vector<double>> ll_traces;
+    std::vector<std::vector<double>> ngroups_traces;
+    for (int c = 0; c < n_chains; ++c){
+        ll_traces.push_back(samples[c]->energies);
+        ngroups_traces.emplace_back(samples[c]->num_groups.begin(), samples[c]->num_groups.end());
+        double ess = effective_sample_size(samples[c]->energies);
+        std::cout<<"chain "<<c<<": final energy "<<cold_model(c).loglike<<", groups "<<cold_model(c).num_groups
+                 <<", effective samples "<<ess<<" ("<<ess/seconds<<" per second)"<<std::endl;
+        if (n_rungs > 1){
+            ensembles[c]->print_swap_rates();
+        }
+    }
+    if (n_chains > 1){
+        std::cout<<"R-hat energy: "<<potential_scale_reduction(ll_traces)<<std::endl;
+        std::cout<<"R-hat num_groups: "<<potential_scale_reduction(ngroups_traces)<<std::endl;
+    }
 
     std::cout<<"Writing data to file."<<std::endl;
-    std::string filename = params.get_saved_data_name();
-    std::string filepath = params.get_save_dir();
-    std::ofstream output_groups(filepath+filename+"_configs.txt");
-    std::ofstream output_ngroups(filepath+filename+"_num_groups.txt");
-    std::ofstream output_group_size(filepath+filename+"_group_size.txt");
-    std::ofstream output_edges(filepath+filename+"_edges.txt");
-    std::ofstream output_pairs(filepath+filename+"_pairs.txt");
-    std::ofstream output_ll(filepath+filename+"_ll.txt");
-
-    for (int el = 0; el < intermediate_states.size(); ++el) {
-        // output decimal representation of groups
-        for(int l = 0; l < intermediate_states[el].size(); ++l){
-            output_groups << intermediate_states[el][l]<<" ";
-        }
-        output_groups << std::endl;
-
-        for(int mu = 0; mu < hcg_edges[el].size(); ++mu){
-            output_edges << hcg_edges[el][mu]<<" ";
-            output_pairs << hcg_pairs[el][mu]<<" ";
-            output_group_size << group_size[el][mu]<<" ";
-        }
-        output_edges << std::endl;
-        output_pairs << std::endl;
-        output_group_size << std::endl;
-        output_ll << energies[el]<< std::endl;
-        output_ngroups << num_groups[el] << std::endl;
-
-    }
-    output_groups.close();
-    output_edges.close();
-    output_pairs.close();
-    output_group_size.close();
-    output_ll.close();
-    std::cout<<"Simulation data saved successfully."<<std::endl;
-    return 0;
+    bool saved = true;
+    for (int c = 0; c < n_chains; ++c){
+        if (writers[c]){
+            saved = writers[c]->close() && saved;
+            if (params.get_text_output()){
+                convert_samples_to_text(sample_path(c), params.get_save_dir(), chain_name(c));
+            }
+        }
+        if (samples[c]->summary){
+            saved = samples[c]->summary->write(params.get_save_dir()/(chain_name(c)+"_summary.txt")) && saved;
+        }
+    }
+    if (saved){
+        std::cout<<"Simulation data saved successfully."<<std::endl;
+    }
+
+    ensembles.clear();
+    chains.clear();
+    free_network(&network);
+    return saved ? 0 : EXIT_FAILURE;
 }
@@ -0,0 +1,60 @@
+//
+// A search for the most likely state of the hierarchical model.
+//
+
+#include "map_search.h"
+#include "checkpoint.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+
+map_search::map_search(int id, const parameters &params, const NETWORK &network, unsigned long seed)
+    : id(id), num_itrs(params.get_max_itr()), start_temperature(params.get_anneal_start_temperature()),
+      end_temperature(params.get_anneal_end_temperature()), model(make_model(params, network, seed)) {
+    best_loglike = model->loglike;
+}
+
+// Saves the model when it beats the best state so far. Saving copies the node lists, so
+// it is only checked every num_nodes iterations.
+void map_search::keep_if_best() {
+    if (best_itr >= 0 && model->loglike <= best_loglike){
+        return;
+    }
+    std::ostringstream out;
+    model->save_state(out);
+    best_state = out.str();
+    best_loglike = model->loglike;
+    best_itr = itr;
+}
+
+void map_search::run() {
+    auto start = std::chrono::steady_clock::now();
+    long check_interval = std::max(1, model->G.nvertices);
+    double log_ratio = std::log(end_temperature/start_temperature);
+    keep_if_best();
+    for (; itr < num_itrs && !stop_requested(); ++itr){
+        if (itr%schedule_interval == 0){
+            double temperature = start_temperature*std::exp(log_ratio*itr/num_itrs);
+            model->beta = 1.0/temperature;
+        }
+        model->get_groups();
+        if ((itr+1)%check_interval == 0){
+            keep_if_best();
+        }
+    }
+    keep_if_best();
+
+    // the saved state carries the random number generator too, which the sweeps do not use
+    std::istringstream in(best_state);
+    model->load_state(in);
+    model->beta = 1.0;
+    while (greedy_sweeps < max_greedy_sweeps){
+        greedy_sweeps++;
+        if (model->greedy_sweep() == 0){
+            break;
+        }
+    }
+    model->remove_empty_groups();
+    seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,44 @@
+//
+// A search for the most likely state of the hierarchical model, for runs that only want
+// the best partition rather than samples of the posterior.
+//
+// The chain is annealed: its temperature falls geometrically from the start to the end
+// temperature over the run, so it explores first and then settles. The best state seen
+// is kept as a saved model state, taken at most once per node's worth of steps so saving
+// costs little next to the moves. Finally the best state is restored and improved by
+// greedy sweeps until no single group change raises the log-likelihood.
+//
+
+#ifndef HCP_MAP_SEARCH_H
+#define HCP_MAP_SEARCH_H
+
+#include "hierarchical_model.h"
+#include "parameters.h"
+#include <memory>
+#include <string>
+
+class map_search {
+    public:
+        int id;
+        long num_itrs;
+        long itr = 0; // next iteration to run
+        double start_temperature;
+        double end_temperature;
+        long schedule_interval = 1000; // iterations between temperature updates
+        int max_greedy_sweeps = 100;
+        std::unique_ptr<hierarchical_model> model;
+
+        std::string best_state; // saved model state of the best state seen
+        double best_loglike;
+        long best_itr = -1;
+        int greedy_sweeps = 0; // sweeps run after annealing
+        double seconds = 0.0; // wall time spent searching
+
+        map_search(int id, const parameters &params, const NETWORK &network, unsigned long seed);
+
+        // anneals, or stops early when a stop is requested, then sweeps the best state
+        void run();
+        void keep_if_best();
+};
+
+#endif //HCP_MAP_SEARCH_H
@@ -0,0 +1,170 @@
+//
+// Multilevel starting states for the sampler.
+//
+
+#include "multilevel_init.h"
+#include "network_builder.h"
+#include "readgml.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <numeric>
+
+namespace {
+    const int COARSE_NODES = 500; // coarsening stops at this many nodes
+    const double MIN_SHRINK = 0.9; // or when a level keeps more than this share of the nodes
+    const long COARSE_SWEEPS = 2000; // sampler steps per node on the coarsest network
+    const long REFINE_SWEEPS = 20; // sampler steps per node on each finer level
+
+    std::mutex output_lock; // chains are started in parallel
+
+    // the groups of every fine node from those of its coarse node, words per node each
+    std::vector<uint64_t> project_groups(const std::vector<uint64_t> &coarse_groups, const std::vector<int> &coarse_of,
+                                         std::size_t words) {
+        std::vector<uint64_t> groups(coarse_of.size()*words);
+        for (std::size_t u = 0; u < coarse_of.size(); ++u){
+            std::copy_n(coarse_groups.begin() + coarse_of[u]*words, words, groups.begin() + u*words);
+        }
+        return groups;
+    }
+
+    void run_sampler(hierarchical_model &model, long steps) {
+        for (long itr = 0; itr < steps; ++itr){
+            model.get_groups();
+        }
+    }
+}
+
+void coarsen_network(const NETWORK &fine, NETWORK *coarse, std::vector<int> &coarse_of, gsl_rng *rng) {
+    int n = fine.nvertices;
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    for (int i = n-1; i > 0; --i){
+        std::swap(order[i], order[gsl_rng_uniform_int(rng, i+1)]);
+    }
+
+    // match every node with its unmatched neighbour of heaviest edge, if it has one
+    coarse_of.assign(n, -1);
+    std::vector<int> first;
+    std::vector<int> second;
+    for (int u : order){
+        if (coarse_of[u] != -1){
+            continue;
+        }
+        int match = -1;
+        double heaviest = 0.0;
+        for (int64_t e = fine.offset[u]; e < fine.offset[u+1]; ++e){
+            int v = fine.target[e];
+            double w = (fine.weight != NULL) ? fine.weight[e] : 1.0;
+            if (coarse_of[v] == -1 && w > heaviest){
+                match = v;
+                heaviest = w;
+            }
+        }
+        coarse_of[u] = first.size();
+        if (match != -1){
+            coarse_of[match] = first.size();
+        }
+        first.push_back(u);
+        second.push_back(match);
+    }
+
+    // the edges of each coarse node are those of its nodes to other coarse nodes, with
+    // the weights of edges to the same coarse node summed
+    int m = first.size();
+    std::vector<int64_t> offset(m+1, 0);
+    std::vector<int32_t> target;
+    std::vector<double> weight;
+    std::vector<std::pair<int, double>> edges;
+    for (int c = 0; c < m; ++c){
+        edges.clear();
+        for (int u : {first[c], second[c]}){
+            if (u == -1){
+                continue;
+            }
+            for (int64_t e = fine.offset[u]; e < fine.offset[u+1]; ++e){
+                int d = coarse_of[fine.target[e]];
+                if (d != c){
+                    edges.emplace_back(d, (fine.weight != NULL) ? fine.weight[e] : 1.0);
+                }
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        for (std::size_t i = 0; i < edges.size(); ++i){
+            if (i > 0 && edges[i].first == edges[i-1].first){
+                weight.back() += edges[i].second;
+            }else{
+                target.push_back(edges[i].first);
+                weight.push_back(edges[i].second);
+            }
+        }
+        offset[c+1] = target.size();
+    }
+
+    coarse->nvertices = m;
+    coarse->directed = 0;
+    coarse->offset = static_cast<int64_t*>(malloc((m+1)*sizeof(int64_t)));
+    coarse->target = static_cast<int32_t*>(malloc(std::max<std::size_t>(1, target.size())*sizeof(int32_t)));
+    coarse->weight = static_cast<double*>(malloc(std::max<std::size_t>(1, weight.size())*sizeof(double)));
+    std::copy(offset.begin(), offset.end(), coarse->offset);
+    std::copy(target.begin(), target.end(), coarse->target);
+    std::copy(weight.begin(), weight.end(), coarse->weight);
+    std::vector<int64_t> ids(m);
+    std::iota(ids.begin(), ids.end(), 0);
+    set_vertex_ids(coarse, ids);
+    coarse->mapping = NULL;
+    coarse->mapping_size = 0;
+}
+
+bool use_multilevel_start(const parameters &params) {
+    return params.get_init_strategy() == init_strategy::multilevel && params.get_initial_group_config().empty();
+}
+
+void multilevel_start(hierarchical_model &model, const parameters &params, unsigned long seed) {
+    gsl_rng *rng = gsl_rng_alloc(gsl_rng_mt19937);
+    gsl_rng_set(rng, seed);
+
+    // levels[0] is the model's own network, which is not owned here
+    std::vector<NETWORK> levels(1, model.G);
+    std::vector<std::vector<int>> coarse_of;
+    while (levels.back().nvertices > COARSE_NODES){
+        NETWORK coarse;
+        std::vector<int> map;
+        coarsen_network(levels.back(), &coarse, map, rng);
+        if (coarse.nvertices > MIN_SHRINK*levels.back().nvertices){
+            free_network(&coarse);
+            break;
+        }
+        levels.push_back(coarse);
+        coarse_of.push_back(std::move(map));
+    }
+    gsl_rng_free(rng);
+    std::lock_guard<std::mutex> guard(output_lock);
+    std::cout<<"multilevel start over "<<levels.size()<<" level(s), coarsest "<<levels.back().nvertices<<" nodes"
+             <<std::endl;
+
+    // sample on the coarsest network, then project and refine a level at a time
+    std::unique_ptr<hierarchical_model> coarse_model;
+    if (levels.size() > 1){
+        coarse_model = make_width_model(params, levels.back(), seed+levels.size());
+        run_sampler(*coarse_model, COARSE_SWEEPS*levels.back().nvertices);
+        for (std::size_t l = levels.size()-1; l-- > 1;){
+            std::vector<uint64_t> groups = project_groups(coarse_model->get_g(), coarse_of[l], coarse_model->group_words());
+            int groups_count = coarse_model->num_groups;
+            coarse_model = make_width_model(params, levels[l], seed+l);
+            coarse_model->set_groups(groups, groups_count);
+            run_sampler(*coarse_model, REFINE_SWEEPS*levels[l].nvertices);
+        }
+        model.set_groups(project_groups(coarse_model->get_g(), coarse_of[0], coarse_model->group_words()),
+                         coarse_model->num_groups);
+    }else{
+        // the network is already small, so the start is refined on the network itself
+        run_sampler(model, COARSE_SWEEPS*model.G.nvertices);
+    }
+    coarse_model.reset();
+    for (std::size_t l = 1; l < levels.size(); ++l){
+        free_network(&levels[l]);
+    }
+}
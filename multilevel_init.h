@@ -0,0 +1,33 @@
+//
+// Multilevel starting states for the sampler.
+//
+// A random start leaves the chain to find the core-periphery structure of the whole
+// network from scratch. Instead, the network is coarsened by heavy-edge matching: the
+// nodes are visited in random order and each unmatched node is merged with the
+// unmatched neighbour it shares the heaviest edge with, the weight of an edge of the
+// coarse network being the number of edges it stands for. This is repeated until the
+// network is small or stops shrinking. The sampler runs on the coarsest network, where
+// moves are cheap and few nodes need to move, and its groups are projected back a level
+// at a time, every node taking the groups of the node it was merged into, with a short
+// run of the sampler on each level to refine them.
+//
+
+#ifndef HCP_MULTILEVEL_INIT_H
+#define HCP_MULTILEVEL_INIT_H
+
+#include "hierarchical_model.h"
+#include "network.h"
+#include <gsl/gsl_rng.h>
+#include <vector>
+
+// Merges the nodes of fine in pairs by heavy-edge matching into coarse, whose arrays are
+// allocated as free_network expects. coarse_of receives the coarse node of each node.
+void coarsen_network(const NETWORK &fine, NETWORK *coarse, std::vector<int> &coarse_of, gsl_rng *rng);
+
+// whether init_strategy asks for a multilevel start, which initial_group_config overrides
+bool use_multilevel_start(const parameters &params);
+
+// Replaces the random groups of model by a multilevel start on its network
+void multilevel_start(hierarchical_model &model, const parameters &params, unsigned long seed);
+
+#endif //HCP_MULTILEVEL_INIT_H
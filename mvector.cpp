@@ -12,16 +12,17 @@ mvector::mvector()
 
 mvector::mvector(std::size_t nrows, std::size_t ncols)
         : _nrows(nrows), _ncols(ncols) {
-    std::fill_n(std::back_inserter(_mvec), _ncols*MAX_NROWS, -3);
+    std::fill_n(std::back_inserter(_mvec), _ncols*_max_nrows, -3);
 }
 
 inline std::size_t mvector::get_idx(std::size_t row, std::size_t col){
     return (_ncols*row + col);
 }
 
-void mvector::set_ncols(std::size_t ncols){
+void mvector::set_ncols(std::size_t ncols, std::size_t max_nrows){
     _ncols = ncols;
-    std::fill_n(std::back_inserter(_mvec), _ncols*MAX_NROWS, -3);
+    _max_nrows = max_nrows;
+    std::fill_n(std::back_inserter(_mvec), _ncols*_max_nrows, -3);
 }
 
 int& mvector::at(std::size_t row, std::size_t col){
@@ -6,6 +6,7 @@
 #define HCP_MVECTOR_H
 
 #include <iostream>
+#include <vector>
 
 class mvector {
 
@@ -13,7 +14,7 @@ class mvector {
 
         std::size_t _ncols;
         std::size_t _nrows;
-        const std::size_t MAX_NROWS = 64;
+        std::size_t _max_nrows = 64;
         std::vector<int> _mvec;
         void copy(const mvector& mvec);
         std::size_t get_idx(std::size_t row, std::size_t col);
@@ -25,7 +26,8 @@ class mvector {
         mvector();
         mvector(std::size_t nrows, std::size_t ncols);
 
-        void set_ncols(std::size_t ncols);
+        // allocates max_nrows rows of ncols entries
+        void set_ncols(std::size_t ncols, std::size_t max_nrows = 64);
         int size();
         int& at(std::size_t row, std::size_t col);
 
@@ -0,0 +1,57 @@
+//
+// Measures what the per-node histograms of neighbour states cost and gain. The network
+// and the model are set up from a parameters file as hcp does, and the same chain of
+// moves is run twice from the same seed, without and with the histograms. For each the
+// memory the histograms take, the time to build them and the moves per second are
+// reported. Both runs make the same moves, so they end at the same log-likelihood.
+//
+// usage: hcp_neighbour_bench <parameters file> [moves]
+//
+
+#include "hierarchical_model.h"
+#include "graph_formats.h"
+#include "parameters.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 3){
+        std::cerr<<"usage: "<<argv[0]<<" <parameters file> [moves]"<<std::endl;
+        return EXIT_FAILURE;
+    }
+    parameters params(argv[1]);
+    if (params.get_error_status() == 1){
+        return EXIT_FAILURE;
+    }
+    long moves = (argc > 2) ? std::stol(argv[2]) : 1000000;
+
+    NETWORK network;
+    read_graph(&network, params.get_graph_path(), params.get_graph_format(), params.get_remap_node_ids(),
+               params.get_read_threads());
+    int64_t edges = network.offset[network.nvertices]/2;
+
+    std::cout<<"histograms\tbytes\tbytes/edge\tbuild s\tmoves/s\tloglike"<<std::endl;
+    for (bool enabled : {false, true}){
+        std::unique_ptr<hierarchical_model> model = make_model(params, network, params.get_seed());
+        model->use_neighbour_histograms(false);
+
+        auto start = std::chrono::steady_clock::now();
+        model->use_neighbour_histograms(enabled);
+        double build = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        for (long itr = 0; itr < moves; ++itr){
+            model->get_groups();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::size_t bytes = model->neighbour_histogram_bytes();
+        std::cout<<(enabled ? "on" : "off")<<"\t"<<bytes<<"\t"<<static_cast<double>(bytes)/std::max<int64_t>(edges, 1)
+                 <<"\t"<<build<<"\t"<<moves/seconds<<"\t"<<model->loglike<<std::endl;
+    }
+    free_network(&network);
+    return 0;
+}
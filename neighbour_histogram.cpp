@@ -0,0 +1,139 @@
+//
+// Histograms of the group states of every node's neighbours.
+//
+
+#include "neighbour_histogram.h"
+#include <cassert>
+
+template <typename state_t>
+neighbour_histogram<state_t>::neighbour_histogram()
+    : _network(NULL) {}
+
+template <typename state_t>
+void neighbour_histogram<state_t>::build(const NETWORK &network, const std::vector<state_t> &g) {
+    _network = &network;
+    int n = network.nvertices;
+    _states.resize(network.offset[n]);
+    _counts.resize(network.offset[n]);
+    _sizes.assign(n, 0);
+    _table_offset.resize(n+1);
+    _table_offset[0] = 0;
+    for (int u = 0; u < n; ++u){
+        int64_t capacity = 1;
+        while (capacity < 2*degree(network, u)){
+            capacity <<= 1;
+        }
+        _table_offset[u+1] = _table_offset[u] + capacity;
+    }
+    _table.assign(_table_offset[n], -1);
+
+    for (int u = 0; u < n; ++u){
+        for (int64_t e = network.offset[u]; e < network.offset[u+1]; ++e){
+            add(u, g[network.target[e]]);
+        }
+    }
+}
+
+template <typename state_t>
+void neighbour_histogram<state_t>::clear() {
+    std::vector<state_t>().swap(_states);
+    std::vector<long long>().swap(_counts);
+    std::vector<int>().swap(_sizes);
+    std::vector<int>().swap(_table);
+    std::vector<int64_t>().swap(_table_offset);
+}
+
+template <typename state_t>
+inline std::size_t neighbour_histogram<state_t>::home(int u, const state_t &state) const {
+    std::size_t mask = _table_offset[u+1] - _table_offset[u] - 1;
+    return ((state_key(state)*0x9E3779B97F4A7C15ULL)>>32)&mask;
+}
+
+// Returns the slot of u's table holding state, or the empty slot where it would be inserted
+template <typename state_t>
+inline std::size_t neighbour_histogram<state_t>::slot_of(int u, const state_t &state) const {
+    const int *table = _table.data() + _table_offset[u];
+    const state_t *states = _states.data() + _network->offset[u];
+    std::size_t mask = _table_offset[u+1] - _table_offset[u] - 1;
+    std::size_t slot = home(u, state);
+    while (table[slot] != -1 && states[table[slot]] != state){
+        slot = (slot+1)&mask;
+    }
+    return slot;
+}
+
+template <typename state_t>
+void neighbour_histogram<state_t>::add(int u, const state_t &state) {
+    int *table = _table.data() + _table_offset[u];
+    int64_t begin = _network->offset[u];
+    std::size_t slot = slot_of(u, state);
+    if (table[slot] == -1){
+        assert(_sizes[u] < degree(*_network, u));
+        table[slot] = _sizes[u];
+        _states[begin + _sizes[u]] = state;
+        _counts[begin + _sizes[u]] = 1;
+        _sizes[u]++;
+    }else{
+        _counts[begin + table[slot]]++;
+    }
+}
+
+template <typename state_t>
+void neighbour_histogram<state_t>::remove(int u, const state_t &state) {
+    int *table = _table.data() + _table_offset[u];
+    state_t *states = _states.data() + _network->offset[u];
+    long long *counts = _counts.data() + _network->offset[u];
+    std::size_t mask = _table_offset[u+1] - _table_offset[u] - 1;
+    std::size_t slot = slot_of(u, state);
+    assert(table[slot] != -1);
+    std::size_t idx = table[slot];
+    if (--counts[idx] > 0){
+        return;
+    }
+
+    // backward shift deletion, as in state_histogram
+    std::size_t hole = slot;
+    std::size_t next = (hole+1)&mask;
+    while (table[next] != -1){
+        std::size_t h = home(u, states[table[next]]);
+        if (((next-h)&mask) >= ((next-hole)&mask)){
+            table[hole] = table[next];
+            hole = next;
+        }
+        next = (next+1)&mask;
+    }
+    table[hole] = -1;
+
+    // move the last state into the freed index so the states stay dense
+    std::size_t last = _sizes[u]-1;
+    if (idx != last){
+        table[slot_of(u, states[last])] = idx;
+        states[idx] = states[last];
+        counts[idx] = counts[last];
+    }
+    _sizes[u]--;
+}
+
+template <typename state_t>
+void neighbour_histogram<state_t>::move(int u, const state_t &old_state, const state_t &new_state) {
+    for (int64_t e = _network->offset[u]; e < _network->offset[u+1]; ++e){
+        int v = _network->target[e];
+        remove(v, old_state);
+        add(v, new_state);
+    }
+}
+
+template <typename state_t>
+std::size_t neighbour_histogram<state_t>::bytes() const {
+    return _states.capacity()*sizeof(state_t) + _counts.capacity()*sizeof(long long)
+           + _sizes.capacity()*sizeof(int) + _table.capacity()*sizeof(int)
+           + _table_offset.capacity()*sizeof(int64_t);
+}
+
+template class neighbour_histogram<uint8_t>;
+template class neighbour_histogram<uint16_t>;
+template class neighbour_histogram<uint32_t>;
+template class neighbour_histogram<uint64_t>;
+template class neighbour_histogram<wide_state<2>>;
+template class neighbour_histogram<wide_state<4>>;
+template class neighbour_histogram<wide_state<8>>;
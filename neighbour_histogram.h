@@ -0,0 +1,57 @@
+//
+// Histograms of the group states of every node's neighbours, for states of type state_t
+// (instantiated for the unsigned integer widths and the wide states in
+// neighbour_histogram.cpp).
+//
+// Node u keeps the distinct states of its neighbours and how many neighbours hold each
+// in its own part [offset[u], offset[u] + size(u)) of two arrays laid out like the
+// adjacency, so they can be handed to the flip kernels like the state_histogram of all
+// nodes. Each node also has an open addressing table of at least twice its degree
+// entries, so moving a neighbour between states costs O(1) rather than O(size(u)).
+//
+
+#ifndef HCP_NEIGHBOUR_HISTOGRAM_H
+#define HCP_NEIGHBOUR_HISTOGRAM_H
+
+#include "group_state.h"
+#include "network.h"
+#include <cstdint>
+#include <vector>
+
+template <typename state_t>
+class neighbour_histogram {
+
+    private:
+        const NETWORK *_network;
+        std::vector<state_t> _states; // distinct neighbour states of each node, at its adjacency offset
+        std::vector<long long> _counts; // number of neighbours holding each state
+        std::vector<int> _sizes; // number of distinct neighbour states of each node
+        std::vector<int> _table; // per-node tables of indices into the node's states, -1 if empty
+        std::vector<int64_t> _table_offset; // start of each node's table, whose size is a power of two
+
+        std::size_t slot_of(int u, const state_t &state) const;
+        std::size_t home(int u, const state_t &state) const;
+        void add(int u, const state_t &state);
+        void remove(int u, const state_t &state);
+
+    public:
+        neighbour_histogram();
+
+        // builds the histograms of every node from the states g of all nodes
+        void build(const NETWORK &network, const std::vector<state_t> &g);
+        // frees the histograms
+        void clear();
+        bool empty() const { return _sizes.empty(); }
+
+        // moves node u from old_state to new_state in the histogram of each of its neighbours
+        void move(int u, const state_t &old_state, const state_t &new_state);
+
+        std::size_t size(int u) const { return _sizes[u]; }
+        const state_t *states(int u) const { return _states.data() + _network->offset[u]; }
+        const long long *counts(int u) const { return _counts.data() + _network->offset[u]; }
+        std::size_t bytes() const;
+
+};
+
+
+#endif //HCP_NEIGHBOUR_HISTOGRAM_H
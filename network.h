@@ -1,29 +1,46 @@
-// Header file for VERTEX, EDGE, and NETWORK data structures
+// Header file for the NETWORK data structure
 //
 // Mark Newman  11 AUG 06
+//
+// Modified to store the network in compressed sparse row form: the neighbours of
+// every vertex are kept together in one array instead of a separately allocated
+// EDGE array per vertex, and the edge weights, which the model does not use, are
+// kept apart so they are not dragged through the cache with the targets.
 
 #ifndef _NETWORK_H
 #define _NETWORK_H
 
-typedef struct {
-    int target;        // Index in the vertex[] array of neighboring vertex.
-    // (Note that this is not necessarily equal to the GML
-    // ID of the neighbor if IDs are nonconsecutive or do
-    // not start at zero.)
-    double weight;     // Weight of edge.  1 if no weight is specified.
-} EDGE;
-
-typedef struct {
-    int id;            // GML ID number of vertex
-    int degree;        // Degree of vertex (out-degree for directed nets)
-    char *label;       // GML label of vertex.  NULL if no label specified
-    EDGE *edge;        // Array of EDGE structs, one for each neighbor
-} VERTEX;
+#include <cstddef>
+#include <cstdint>
 
 typedef struct {
     int nvertices;     // Number of vertices in network
     int directed;      // 1 = directed network, 0 = undirected
-    VERTEX *vertex;    // Array of VERTEX structs, one for each vertex
+    int64_t *offset;   // Neighbours of vertex u are target[offset[u]] .. target[offset[u+1]-1],
+                       // nvertices+1 entries
+    int32_t *target;   // Index of each neighbouring vertex.  (Note that this is not
+                       // necessarily equal to the GML ID of the neighbor if IDs are
+                       // nonconsecutive or do not start at zero.)
+    double *weight;    // Weight of each edge, parallel to target.  NULL if no edge
+                       // specifies a weight, in which case all weights are 1
+    int64_t *id;       // GML ID number of each vertex
+    int64_t *label_offset; // Label of vertex u starts at label_data + label_offset[u], and
+                       // is NUL terminated.  -1 if no label specified
+    char *label_data;  // All labels, one after the other
+    void *mapping;     // Cache file the arrays point into, NULL if they were allocated
+    std::size_t mapping_size;
 } NETWORK;
 
+// Degree of vertex u (out-degree for directed nets)
+inline int degree(const NETWORK &network, int u)
+{
+    return network.offset[u+1] - network.offset[u];
+}
+
+// GML label of vertex u, or NULL if it has none
+inline const char *label(const NETWORK &network, int u)
+{
+    return (network.label_offset[u]<0) ? NULL : network.label_data + network.label_offset[u];
+}
+
 #endif
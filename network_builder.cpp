@@ -0,0 +1,299 @@
+//
+// Assembles a NETWORK from the edges collected by the readers.
+//
+
+#include "network_builder.h"
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <utility>
+
+id_index::id_index(const std::vector<int64_t> &ids) : _min_id(0), _range(0), _dense(true) {
+    int n = ids.size();
+    if (n == 0){
+        return;
+    }
+    int64_t max_id = ids[0];
+    _min_id = ids[0];
+    for (int64_t id : ids){
+        _min_id = std::min(_min_id, id);
+        max_id = std::max(max_id, id);
+    }
+    // node IDs are usually close to 0..n-1, where a table is both the fastest and the
+    // smallest lookup; widely scattered IDs fall back to a hash
+    _dense = static_cast<uint64_t>(max_id - _min_id) < 4ULL*n + 1024;
+    if (_dense){
+        _range = max_id - _min_id + 1;
+        _table.assign(_range, -1);
+        for (int i = n-1; i >= 0; --i){
+            _table[ids[i] - _min_id] = i;
+        }
+    }else{
+        _hash.reserve(n);
+        for (int i = n-1; i >= 0; --i){
+            _hash[ids[i]] = i;
+        }
+    }
+}
+
+namespace {
+    // replaces values[0..m) by their running sums
+    void running_sum(int64_t *values, std::size_t m, thread_pool &pool) {
+        std::size_t parts = pool.size();
+        std::vector<int64_t> totals(parts, 0);
+        for (std::size_t p = 0; p < parts; ++p){
+            pool.submit([=, &totals]() {
+                int64_t sum = 0;
+                for (std::size_t i = m*p/parts; i < m*(p+1)/parts; ++i){
+                    sum += values[i];
+                    values[i] = sum;
+                }
+                totals[p] = sum;
+            });
+        }
+        pool.wait();
+        int64_t carry = 0;
+        for (std::size_t p = 0; p < parts; ++p){
+            std::swap(carry, totals[p]);
+            carry += totals[p];
+        }
+        for (std::size_t p = 1; p < parts; ++p){
+            pool.submit([=, &totals]() {
+                for (std::size_t i = m*p/parts; i < m*(p+1)/parts; ++i){
+                    values[i] += totals[p];
+                }
+            });
+        }
+        pool.wait();
+    }
+
+    // splits the vertices into one range per worker holding about the same number of
+    // adjacency entries
+    std::vector<int> balanced_ranges(const int64_t *offset, int n, std::size_t parts) {
+        std::vector<int> bounds(parts+1, n);
+        bounds[0] = 0;
+        for (std::size_t p = 1; p < parts; ++p){
+            int64_t entries = offset[n]*static_cast<int64_t>(p)/static_cast<int64_t>(parts);
+            bounds[p] = std::lower_bound(offset, offset + n, entries) - offset;
+        }
+        return bounds;
+    }
+
+    template <typename F>
+    void for_each_range(thread_pool &pool, const std::vector<int> &bounds, F f) {
+        for (std::size_t p = 0; p+1 < bounds.size(); ++p){
+            int begin = bounds[p];
+            int end = bounds[p+1];
+            if (begin < end){
+                pool.submit([&f, begin, end]() { f(begin, end); });
+            }
+        }
+        pool.wait();
+    }
+}
+
+int64_t build_adjacency(NETWORK *network, int n, int directed, const std::vector<index_edge> &edges,
+                        thread_pool &pool) {
+    network->nvertices = n;
+    network->directed = directed;
+    network->mapping = NULL;
+    network->mapping_size = 0;
+
+    // The vertices are grouped into buckets of 2^shift consecutive vertices, several
+    // per thread, and the edges into one chunk per thread. Every chunk counts the
+    // adjacency entries it gives each bucket, so that it can write them into a place
+    // of its own next to the other entries of the bucket. Each bucket then builds its
+    // rows on its own, so no two threads ever write to the same counter.
+    std::size_t chunks = pool.size();
+    int shift = 0;
+    while ((static_cast<int64_t>(n) >> shift) > 16*static_cast<int64_t>(chunks)){
+        shift++;
+    }
+    std::size_t buckets = (n > 0) ? ((n-1) >> shift) + 1 : 0;
+    std::vector<int64_t> start(chunks*buckets, 0);
+    std::vector<int64_t> self_loops(chunks, 0);
+    std::vector<char> chunk_weighted(chunks, 0);
+    for (std::size_t c = 0; c < chunks; ++c){
+        pool.submit([&, c]() {
+            int64_t *count = start.data() + c*buckets;
+            int64_t loops = 0;
+            bool has_weight = false;
+            for (std::size_t i = edges.size()*c/chunks; i < edges.size()*(c+1)/chunks; ++i){
+                const index_edge &e = edges[i];
+                if (e.source == e.target){
+                    loops++;
+                    continue;
+                }
+                count[e.source >> shift]++;
+                if (!directed){
+                    count[e.target >> shift]++;
+                }
+                has_weight = has_weight || e.weight != 1.0;
+            }
+            self_loops[c] = loops;
+            chunk_weighted[c] = has_weight;
+        });
+    }
+    pool.wait();
+
+    // turn the counts into starting positions, bucket by bucket and chunk by chunk
+    std::vector<int64_t> bucket_start(buckets+1);
+    int64_t nentries = 0;
+    for (std::size_t b = 0; b < buckets; ++b){
+        bucket_start[b] = nentries;
+        for (std::size_t c = 0; c < chunks; ++c){
+            int64_t count = start[c*buckets + b];
+            start[c*buckets + b] = nentries;
+            nentries += count;
+        }
+    }
+    bucket_start[buckets] = nentries;
+    bool weighted = std::count(chunk_weighted.begin(), chunk_weighted.end(), 1) > 0;
+
+    struct arc {
+        int32_t row;
+        int32_t column;
+    };
+    std::unique_ptr<arc[]> arcs(new arc[nentries]);
+    std::unique_ptr<double[]> arc_weight(weighted ? new double[nentries] : nullptr);
+    for (std::size_t c = 0; c < chunks; ++c){
+        pool.submit([&, c]() {
+            int64_t *next = start.data() + c*buckets;
+            for (std::size_t i = edges.size()*c/chunks; i < edges.size()*(c+1)/chunks; ++i){
+                const index_edge &e = edges[i];
+                if (e.source == e.target){
+                    continue;
+                }
+                int64_t k = next[e.source >> shift]++;
+                arcs[k] = {e.source, e.target};
+                if (weighted){
+                    arc_weight[k] = e.weight;
+                }
+                if (!directed){
+                    k = next[e.target >> shift]++;
+                    arcs[k] = {e.target, e.source};
+                    if (weighted){
+                        arc_weight[k] = e.weight;
+                    }
+                }
+            }
+        });
+    }
+    pool.wait();
+
+    // Every bucket counts the degrees of its rows, places its entries and sorts the
+    // rows, which makes the network the same whatever the number of threads and brings
+    // repeated edges together. They are reduced to the one with the largest weight,
+    // and the number of neighbours kept goes into kept[u].
+    int64_t *offset = static_cast<int64_t*>(malloc((n+1)*sizeof(int64_t)));
+    int32_t *target = static_cast<int32_t*>(malloc(nentries*sizeof(int32_t)));
+    double *weight = weighted ? static_cast<double*>(malloc(nentries*sizeof(double))) : NULL;
+    std::vector<int64_t> kept(n);
+    offset[n] = nentries;
+    for (std::size_t b = 0; b < buckets; ++b){
+        pool.submit([&, b]() {
+            int low = b << shift;
+            int high = std::min<int64_t>(n, static_cast<int64_t>(b+1) << shift);
+            int64_t first = bucket_start[b];
+            int64_t last = bucket_start[b+1];
+            std::fill(offset + low, offset + high, 0);
+            for (int64_t k = first; k < last; ++k){
+                offset[arcs[k].row]++;
+            }
+            int64_t position = first;
+            for (int u = low; u < high; ++u){
+                int64_t degree = offset[u];
+                offset[u] = position;
+                kept[u] = position;
+                position += degree;
+            }
+            for (int64_t k = first; k < last; ++k){
+                int64_t entry = kept[arcs[k].row]++;
+                target[entry] = arcs[k].column;
+                if (weight != NULL){
+                    weight[entry] = arc_weight[k];
+                }
+            }
+
+            std::vector<std::pair<int32_t, double>> row;
+            for (int u = low; u < high; ++u){
+                // offset[high] belongs to the next bucket
+                int64_t begin = offset[u];
+                int64_t end = (u+1 < high) ? offset[u+1] : last;
+                if (weight == NULL){
+                    std::sort(target + begin, target + end);
+                    kept[u] = std::unique(target + begin, target + end) - (target + begin);
+                    continue;
+                }
+                row.clear();
+                for (int64_t e = begin; e < end; ++e){
+                    row.emplace_back(target[e], -weight[e]);
+                }
+                std::sort(row.begin(), row.end());
+                int64_t count = 0;
+                for (std::size_t i = 0; i < row.size(); ++i){
+                    if (i == 0 || row[i].first != row[i-1].first){
+                        target[begin + count] = row[i].first;
+                        weight[begin + count] = -row[i].second;
+                        count++;
+                    }
+                }
+                kept[u] = count;
+            }
+        });
+    }
+    pool.wait();
+    arcs.reset();
+    arc_weight.reset();
+
+    int64_t removed = nentries;
+    for (int u = 0; u < n; ++u){
+        removed -= kept[u];
+    }
+    if (removed > 0){
+        // copy the remaining neighbours into arrays of the final size
+        int64_t *kept_offset = static_cast<int64_t*>(malloc((n+1)*sizeof(int64_t)));
+        kept_offset[0] = 0;
+        parallel_ranges(pool, n, [&](std::size_t begin, std::size_t end) {
+            std::copy(kept.begin() + begin, kept.begin() + end, kept_offset + begin + 1);
+        });
+        running_sum(kept_offset + 1, n, pool);
+        int64_t kept_entries = kept_offset[n];
+        int32_t *kept_target = static_cast<int32_t*>(malloc(kept_entries*sizeof(int32_t)));
+        double *kept_weight = weighted ? static_cast<double*>(malloc(kept_entries*sizeof(double))) : NULL;
+        for_each_range(pool, balanced_ranges(offset, n, pool.size()), [&](int begin, int end) {
+            for (int u = begin; u < end; ++u){
+                std::copy(target + offset[u], target + offset[u] + kept[u], kept_target + kept_offset[u]);
+                if (weight != NULL){
+                    std::copy(weight + offset[u], weight + offset[u] + kept[u], kept_weight + kept_offset[u]);
+                }
+            }
+        });
+        free(offset);
+        free(target);
+        free(weight);
+        offset = kept_offset;
+        target = kept_target;
+        weight = kept_weight;
+    }
+
+    network->offset = offset;
+    network->target = target;
+    network->weight = weight;
+    int64_t loops = 0;
+    for (int64_t count : self_loops){
+        loops += count;
+    }
+    return loops + (directed ? removed : removed/2);
+}
+
+void set_vertex_ids(NETWORK *network, const std::vector<int64_t> &ids) {
+    int n = ids.size();
+    network->id = static_cast<int64_t*>(malloc(n*sizeof(int64_t)));
+    network->label_offset = static_cast<int64_t*>(malloc(n*sizeof(int64_t)));
+    network->label_data = NULL;
+    for (int u = 0; u < n; ++u){
+        network->id[u] = ids[u];
+        network->label_offset[u] = -1;
+    }
+}
@@ -0,0 +1,59 @@
+//
+// Assembles a NETWORK from the edges collected by the readers.
+//
+
+#ifndef HCP_NETWORK_BUILDER_H
+#define HCP_NETWORK_BUILDER_H
+
+#include "network.h"
+#include "thread_pool.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// an edge between vertex indices, as collected before the adjacency arrays are built
+struct index_edge {
+    int32_t source;
+    int32_t target;
+    double weight;
+};
+
+// Maps node IDs to vertex indices. The IDs are given in vertex order; a direct table
+// indexed by ID is used when they are reasonably dense, and a hash table otherwise.
+// Repeated IDs map to their first vertex.
+class id_index {
+
+    private:
+        int64_t _min_id;
+        int64_t _range;
+        bool _dense;
+        std::vector<int> _table;
+        std::unordered_map<int64_t, int> _hash;
+
+    public:
+        explicit id_index(const std::vector<int64_t> &ids);
+
+        // vertex index of id, or -1 if no vertex has it
+        int find(int64_t id) const {
+            if (_dense){
+                int64_t idx = id - _min_id;
+                return (idx >= 0 && idx < _range) ? _table[idx] : -1;
+            }
+            auto it = _hash.find(id);
+            return (it == _hash.end()) ? -1 : it->second;
+        }
+};
+
+// Allocates and fills the offset, target and weight arrays of a network with n
+// vertices by a counting sort spread over the threads of pool: a degree pass, a
+// running sum and a scatter. The model is defined on simple graphs, so self-loops are
+// dropped and repeated edges are merged, keeping the largest weight. The neighbours of
+// every vertex end up in increasing order, and the weight array is only kept if some
+// edge has a weight other than 1. Returns the number of edges dropped.
+int64_t build_adjacency(NETWORK *network, int n, int directed, const std::vector<index_edge> &edges,
+                        thread_pool &pool);
+
+// Gives every vertex the ID given and no label
+void set_vertex_ids(NETWORK *network, const std::vector<int64_t> &ids);
+
+#endif //HCP_NETWORK_BUILDER_H
@@ -7,20 +7,26 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <thread>
+#include <algorithm>
+#include <cmath>
 
 parameters::parameters(std::string file_name)
 {
-    read_params(file_name);
-}
-
-void parameters::read_params(std::string file_name) {
-
-
     std::ifstream file{file_name};
     if(file.fail()){
         std::cerr << "Error reading: "<<file_name;
         exit(EXIT_FAILURE);
     }
+    read_params(file);
+}
+
+parameters::parameters(std::istream &file)
+{
+    read_params(file);
+}
+
+void parameters::read_params(std::istream &file) {
 
     std::string line;
     while(std::getline(file, line) )
@@ -41,7 +47,7 @@ void parameters::read_params(std::string file_name) {
             }else if(key == "max_num_groups"){
                 int value;
                 is_line >> value;
-                if (value > 0 && value <= 64) {
+                if (value > 0 && value <= 512) {
                     max_num_groups = value;
                 } else {
                     std::cout << "Warning: unsupported maximum number of groups. Using default value instead."
@@ -51,14 +57,121 @@ void parameters::read_params(std::string file_name) {
             }else if(key == "initial_num_groups"){
                 int value;
                 is_line >> value;
-                if (value > 0 && value <= 64) {
+                if (value > 0 && value <= 512) {
                     initial_num_groups = value;
                 } else {
                     std::cout << "Warning: unsupported number of groups. Using default value instead."
                               << std::endl;
                 }
                 std::cout << "initial_num_groups: " << initial_num_groups << std::endl;
-            }else if(key == "gml_path"){
+            }else if(key == "num_chains"){
+                int value;
+                is_line >> value;
+                if (value > 0) {
+                    num_chains = value;
+                } else {
+                    std::cout << "Warning: unsupported number of chains. Using default value instead."
+                              << std::endl;
+                }
+                std::cout << "num_chains: " << num_chains << std::endl;
+            }else if(key == "num_threads"){
+                int value;
+                is_line >> value;
+                if (value > 0) {
+                    num_threads = value;
+                } else {
+                    std::cout << "Warning: unsupported number of threads. Using default value instead."
+                              << std::endl;
+                }
+                std::cout << "num_threads: " << num_threads << std::endl;
+            }else if(key == "read_threads"){
+                int value;
+                is_line >> value;
+                if (value > 0) {
+                    read_threads = value;
+                } else {
+                    std::cout << "Warning: unsupported number of threads. Using default value instead."
+                              << std::endl;
+                }
+                std::cout << "read_threads: " << read_threads << std::endl;
+            }else if(key == "seed"){
+                unsigned long value;
+                if (is_line >> value) {
+                    seed = value;
+                } else {
+                    std::cout << "Warning: unsupported seed. Seeding from the clock instead."
+                              << std::endl;
+                }
+                std::cout << "seed: " << seed << std::endl;
+            }else if(key == "temperatures"){
+                double value;
+                std::vector<double> ladder{};
+                while ( is_line >> value ) {
+                    if (value >= 1.0) {
+                        ladder.push_back(value);
+                    } else {
+                        std::cout << "Warning: ignoring temperature below 1: " << value << std::endl;
+                    }
+                }
+                temperatures = ladder;
+            }else if(key == "num_temperatures"){
+                int value;
+                is_line >> value;
+                if (value > 0) {
+                    num_temperatures = value;
+                } else {
+                    std::cout << "Warning: unsupported number of temperatures. Using default value instead."
+                              << std::endl;
+                }
+                std::cout << "num_temperatures: " << num_temperatures << std::endl;
+            }else if(key == "max_temperature"){
+                double value;
+                is_line >> value;
+                if (value > 1.0) {
+                    max_temperature = value;
+                } else {
+                    std::cout << "Warning: unsupported maximum temperature. Using default value instead."
+                              << std::endl;
+                }
+                std::cout << "max_temperature: " << max_temperature << std::endl;
+            }else if(key == "swap_interval"){
+                long value;
+                is_line >> value;
+                if (value > 0) {
+                    swap_interval = value;
+                } else {
+                    std::cout << "Warning: unsupported swap interval. Using default value instead."
+                              << std::endl;
+                }
+                std::cout << "swap_interval: " << swap_interval << std::endl;
+            }else if(key == "checkpoint_interval"){
+                long value;
+                is_line >> value;
+                if (value >= 0) {
+                    checkpoint_interval = value;
+                } else {
+                    std::cout << "Warning: unsupported checkpoint interval. Using default value instead."
+                              << std::endl;
+                }
+                std::cout << "checkpoint_interval: " << checkpoint_interval << std::endl;
+            }else if(key == "stats_interval"){
+                long value;
+                is_line >> value;
+                if (value >= 0) {
+                    stats_interval = value;
+                } else {
+                    std::cout << "Warning: unsupported stats interval. Using default value instead."
+                              << std::endl;
+                }
+                std::cout << "stats_interval: " << stats_interval << std::endl;
+            }else if(key == "resume_from"){
+                std::string value;
+                is_line >> value;
+                if (!value.empty()) {
+                    resume_from = value;
+                    std::cout << "resume_from: " << resume_from << std::endl;
+                }
+            }else if(key == "gml_path" || key == "graph_path"){
                 std::string value;
                 is_line >> value;
                 if( value.empty()){
@@ -66,9 +179,115 @@ void parameters::read_params(std::string file_name) {
                     error_status = 1;
                     return;
                 }else{
-                    gml_path = value;
-                    std::cout<<"gml_path: "<<gml_path<<std::endl;
+                    graph_path = value;
+                    std::cout<<key<<": "<<graph_path<<std::endl;
+                }
+            }else if(key == "graph_format"){
+                std::string value;
+                is_line >> value;
+                if (value == "auto") {
+                    input_format = graph_format::automatic;
+                } else if (value == "gml") {
+                    input_format = graph_format::gml;
+                } else if (value == "edgelist") {
+                    input_format = graph_format::edge_list;
+                } else if (value == "mtx") {
+                    input_format = graph_format::matrix_market;
+                } else {
+                    std::cout << "Warning: unsupported graph format. Choosing it from the file name instead."
+                              << std::endl;
+                    value = "auto";
                 }
+                std::cout << "graph_format: " << value << std::endl;
+            }else if(key == "remap_node_ids"){
+                std::string value;
+                is_line >> value;
+                if (value == "true") {
+                    remap_node_ids = true;
+                } else if (value == "false") {
+                    remap_node_ids = false;
+                } else {
+                    std::cout << "Warning: unsupported value for remap_node_ids. Using default value instead."
+                              << std::endl;
+                }
+                std::cout << "remap_node_ids: " << (remap_node_ids ? "true" : "false") << std::endl;
+            }else if(key == "mode"){
+                std::string value;
+                is_line >> value;
+                if (value == "sample") {
+                    mode = run_mode::sample;
+                } else if (value == "map") {
+                    mode = run_mode::map;
+                } else {
+                    std::cout << "Warning: unsupported mode. Sampling instead."
+                              << std::endl;
+                }
+                std::cout << "mode: " << (mode == run_mode::map ? "map" : "sample") << std::endl;
+            }else if(key == "init_strategy"){
+                std::string value;
+                is_line >> value;
+                if (value == "random") {
+                    init = init_strategy::random;
+                } else if (value == "multilevel") {
+                    init = init_strategy::multilevel;
+                } else {
+                    std::cout << "Warning: unsupported initialization strategy. Using random groups instead."
+                              << std::endl;
+                }
+                std::cout << "init_strategy: " << (init == init_strategy::multilevel ? "multilevel" : "random")
+                          << std::endl;
+            }else if(key == "anneal_start_temperature"){
+                double value;
+                is_line >> value;
+                if (value > 0.0) {
+                    anneal_start_temperature = value;
+                } else {
+                    std::cout << "Warning: unsupported annealing start temperature. Using default value instead."
+                              << std::endl;
+                }
+                std::cout << "anneal_start_temperature: " << anneal_start_temperature << std::endl;
+            }else if(key == "anneal_end_temperature"){
+                double value;
+                is_line >> value;
+                if (value > 0.0) {
+                    anneal_end_temperature = value;
+                } else {
+                    std::cout << "Warning: unsupported annealing end temperature. Using default value instead."
+                              << std::endl;
+                }
+                std::cout << "anneal_end_temperature: " << anneal_end_temperature << std::endl;
+            }else if(key == "gibbs_fraction"){
+                double value;
+                is_line >> value;
+                if (value >= 0.0 && value <= 1.0) {
+                    gibbs_fraction = value;
+                } else {
+                    std::cout << "Warning: unsupported Gibbs fraction. Using default value instead."
+                              << std::endl;
+                }
+                std::cout << "gibbs_fraction: " << gibbs_fraction << std::endl;
+            }else if(key == "gibbs_max_groups"){
+                int value;
+                is_line >> value;
+                if (value >= 1 && value <= 20) {
+                    gibbs_max_groups = value;
+                } else {
+                    std::cout << "Warning: unsupported Gibbs maximum number of groups. Using default value instead."
+                              << std::endl;
+                }
+                std::cout << "gibbs_max_groups: " << gibbs_max_groups << std::endl;
+            }else if(key == "neighbour_histograms"){
+                std::string value;
+                is_line >> value;
+                if (value == "true") {
+                    neighbour_histograms = true;
+                } else if (value == "false") {
+                    neighbour_histograms = false;
+                } else {
+                    std::cout << "Warning: unsupported value for neighbour_histograms. Using default value instead."
+                              << std::endl;
+                }
+                std::cout << "neighbour_histograms: " << (neighbour_histograms ? "true" : "false") << std::endl;
             }else if (key == "initial_group_config"){
                     uint64_t value;
                     std::vector<uint64_t> group_configs{};
@@ -87,6 +306,40 @@ void parameters::read_params(std::string file_name) {
                               << std::endl;
                 }
 
+            }else if(key == "sample_format"){
+                std::string value;
+                is_line >> value;
+                if (value == "text") {
+                    text_output = true;
+                    sample_file = true;
+                } else if (value == "binary") {
+                    text_output = false;
+                    sample_file = true;
+                } else if (value == "none") {
+                    text_output = false;
+                    sample_file = false;
+                } else {
+                    std::cout << "Warning: unsupported sample format. Using binary instead."
+                              << std::endl;
+                }
+                std::cout << "sample_format: " << (!sample_file ? "none" : text_output ? "text" : "binary")
+                          << std::endl;
+            }else if(key == "posterior_summary"){
+                std::string value;
+                is_line >> value;
+                if (value == "none") {
+                    summary = summary_level::none;
+                } else if (value == "nodes") {
+                    summary = summary_level::nodes;
+                } else if (value == "neighbours") {
+                    summary = summary_level::neighbours;
+                } else {
+                    std::cout << "Warning: unsupported posterior summary. Using default value instead."
+                              << std::endl;
+                }
+                std::cout << "posterior_summary: " << (summary == summary_level::neighbours ? "neighbours"
+                                                       : summary == summary_level::nodes ? "nodes" : "none")
+                          << std::endl;
             }else if(key == "save_directory"){
                 std::string value;
                 is_line >> value;
@@ -105,6 +358,35 @@ void parameters::read_params(std::string file_name) {
 
         }
     }
+    // an explicit temperature list wins over a geometric ladder; the first rung always
+    // samples the posterior itself
+    if (temperatures.empty()){
+        for (int k = 0; k < num_temperatures; ++k){
+            double frac = (num_temperatures > 1) ? static_cast<double>(k)/(num_temperatures-1) : 0.0;
+            temperatures.push_back(std::pow(max_temperature, frac));
+        }
+    }
+    std::sort(temperatures.begin(), temperatures.end());
+    if (temperatures.front() != 1.0){
+        temperatures.insert(temperatures.begin(), 1.0);
+    }
+    if (temperatures.size() > 1){
+        std::cout << "temperatures:";
+        for (double t : temperatures){
+            std::cout << " " << t;
+        }
+        std::cout << std::endl;
+    }
+
+    if (num_threads == 0){
+        // one thread per chain, up to the number of cores
+        int cores = std::thread::hardware_concurrency();
+        int replicas = num_chains*static_cast<int>(temperatures.size());
+        num_threads = std::max(1, std::min(replicas, cores));
+    }
+    if (read_threads == 0){
+        read_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
     if (max_num_groups < initial_num_groups){
         std::cout<<"initial number of groups is greater than maximum number of groups."<<std::endl;
         std::cout<<"Using default value instead."<<std::endl;
@@ -129,8 +411,16 @@ long  parameters::get_max_itr() const {
     return max_itr;
 }
 
-const std::string &parameters::get_gml_path() const {
-    return gml_path;
+const std::string &parameters::get_graph_path() const {
+    return graph_path;
+}
+
+graph_format parameters::get_graph_format() const {
+    return input_format;
+}
+
+bool parameters::get_remap_node_ids() const {
+    return remap_node_ids;
 }
 
 const std::string &parameters::get_saved_data_name() const {
@@ -144,3 +434,79 @@ const std::filesystem::path &parameters::get_save_dir() const {
 const std::vector<uint64_t> &parameters::get_initial_group_config() const {
     return initial_group_config;
 }
+
+int parameters::get_num_chains() const {
+    return num_chains;
+}
+
+int parameters::get_num_threads() const {
+    return num_threads;
+}
+
+int parameters::get_read_threads() const {
+    return read_threads;
+}
+
+unsigned long parameters::get_seed() const {
+    return seed;
+}
+
+const std::vector<double> &parameters::get_temperatures() const {
+    return temperatures;
+}
+
+long parameters::get_swap_interval() const {
+    return swap_interval;
+}
+
+bool parameters::get_text_output() const {
+    return text_output;
+}
+
+bool parameters::get_sample_file() const {
+    return sample_file;
+}
+
+summary_level parameters::get_summary() const {
+    return summary;
+}
+
+long parameters::get_checkpoint_interval() const {
+    return checkpoint_interval;
+}
+
+long parameters::get_stats_interval() const {
+    return stats_interval;
+}
+
+bool parameters::get_neighbour_histograms() const {
+    return neighbour_histograms;
+}
+
+double parameters::get_gibbs_fraction() const {
+    return gibbs_fraction;
+}
+
+int parameters::get_gibbs_max_groups() const {
+    return gibbs_max_groups;
+}
+
+run_mode parameters::get_mode() const {
+    return mode;
+}
+
+init_strategy parameters::get_init_strategy() const {
+    return init;
+}
+
+double parameters::get_anneal_start_temperature() const {
+    return anneal_start_temperature;
+}
+
+double parameters::get_anneal_end_temperature() const {
+    return anneal_end_temperature;
+}
+
+const std::string &parameters::get_resume_from() const {
+    return resume_from;
+}
@@ -10,19 +10,64 @@
 #include <any>
 #include <vector>
 #include <filesystem>
+#include <istream>
+#include <ctime>
+#include "graph_formats.h"
+
+// What a run does: sample the posterior, or search for its most likely state
+enum class run_mode {
+    sample,
+    map
+};
+
+// How the groups of a run without initial_group_config are first assigned
+enum class init_strategy {
+    random,
+    multilevel
+};
+
+// What a run accumulates about the posterior as it goes, see posterior_summary.h
+enum class summary_level {
+    none,
+    nodes,     // group marginals of every node, the number of groups and the log-likelihood
+    neighbours // and how often the ends of every edge share their innermost group
+};
 
 class parameters {
 
     private:
-        void read_params(std::string file_name);
+        void read_params(std::istream &file);
         int error_status = 0;
         long max_itr = 1000000000;
         int max_num_groups = 64;
         int initial_num_groups = 2;
         std::vector<uint64_t> initial_group_config;
+        int num_chains = 1;
+        int num_threads = 0;
+        int read_threads = 0;
+        unsigned long seed = time(NULL);
+        std::vector<double> temperatures;
+        int num_temperatures = 1;
+        double max_temperature = 10.0;
+        long swap_interval = 1000;
+        long checkpoint_interval = 0;
+        long stats_interval = 0;
+        bool neighbour_histograms = false;
+        double gibbs_fraction = 0.0;
+        int gibbs_max_groups = 4;
+        run_mode mode = run_mode::sample;
+        init_strategy init = init_strategy::random;
+        double anneal_start_temperature = 1.0;
+        double anneal_end_temperature = 0.01;
+        std::string resume_from = "";
 
-        std::string gml_path = "";
+        std::string graph_path = "";
+        graph_format input_format = graph_format::automatic;
+        bool remap_node_ids = true;
         std::string saved_data_name = "data";
+        bool text_output = false;
+        bool sample_file = true;
+        summary_level summary = summary_level::none;
         std::filesystem::path save_dir = std::filesystem::current_path();
 
 
@@ -30,14 +75,37 @@ class parameters {
 
     public:
         parameters(std::string file_name);
+        // the parameters given as "key: value" lines, for tools that set up runs themselves
+        explicit parameters(std::istream &file);
 
         int get_error_status() const;
         int get_max_num_groups() const;
         int get_initial_num_groups() const;
         long get_max_itr() const;
         const std::vector<uint64_t> &get_initial_group_config() const;
-        const std::string &get_gml_path() const;
+        int get_num_chains() const;
+        int get_num_threads() const;
+        int get_read_threads() const;
+        unsigned long get_seed() const;
+        const std::vector<double> &get_temperatures() const;
+        long get_swap_interval() const;
+        long get_checkpoint_interval() const;
+        long get_stats_interval() const;
+        bool get_neighbour_histograms() const;
+        double get_gibbs_fraction() const;
+        int get_gibbs_max_groups() const;
+        run_mode get_mode() const;
+        init_strategy get_init_strategy() const;
+        double get_anneal_start_temperature() const;
+        double get_anneal_end_temperature() const;
+        const std::string &get_resume_from() const;
+        const std::string &get_graph_path() const;
+        graph_format get_graph_format() const;
+        bool get_remap_node_ids() const;
         const std::string &get_saved_data_name() const;
+        bool get_text_output() const;
+        bool get_sample_file() const;
+        summary_level get_summary() const;
         const std::filesystem::path &get_save_dir() const;
 
 
@@ -0,0 +1,82 @@
+//
+// Synthetic networks with a planted nested core-periphery structure.
+//
+
+#include "planted_network.h"
+#include "network_builder.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+
+void planted_core_periphery(NETWORK *network, std::vector<int> &level, const planted_options &options,
+                            thread_pool &pool) {
+    std::mt19937_64 rng(options.seed);
+    int n = options.nodes;
+    int depth = options.depth;
+
+    // core_size[l] nodes are in core l or deeper; core_size[depth+1] is 0
+    std::vector<int64_t> core_size(depth+2, 0);
+    for (int l = 0; l <= depth; ++l){
+        core_size[l] = std::max<int64_t>(2, std::llround(n*std::pow(options.core_fraction, l)));
+    }
+    core_size[0] = n;
+
+    // pairs[l] pairs of nodes have core l as the innermost one both are in
+    std::vector<double> pairs(depth+1);
+    double weighted_pairs = 0.0;
+    for (int l = 0; l <= depth; ++l){
+        auto all_pairs = [](double m) { return 0.5*m*(m-1); };
+        pairs[l] = all_pairs(core_size[l]) - all_pairs(core_size[l+1]);
+        weighted_pairs += pairs[l]*std::pow(options.density_ratio, l);
+    }
+    double p0 = 0.5*n*options.degree/weighted_pairs;
+
+    // the position of a vertex in the random order decides its cores
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), rng);
+    level.assign(n, 0);
+    for (int l = 1; l <= depth; ++l){
+        for (int64_t i = 0; i < core_size[l]; ++i){
+            level[order[i]] = l;
+        }
+    }
+
+    // Sparse levels draw their number of edges and then that many random pairs between
+    // positions in the core but not both in the next one, leaving the few repeats to be
+    // merged. Dense levels, which are small, go through their pairs one by one.
+    std::vector<index_edge> edges;
+    for (int l = 0; l <= depth; ++l){
+        double p = std::min(1.0, p0*std::pow(options.density_ratio, l));
+        int64_t outer = core_size[l];
+        int64_t inner = core_size[l+1];
+        if (p > 0.25){
+            std::bernoulli_distribution keep(p);
+            for (int64_t i = 0; i < outer; ++i){
+                for (int64_t j = std::max(i+1, inner); j < outer; ++j){
+                    if (keep(rng)){
+                        edges.push_back({order[i], order[j], 1.0});
+                    }
+                }
+            }
+        }else{
+            std::binomial_distribution<int64_t> count(std::llround(pairs[l]), p);
+            std::uniform_int_distribution<int64_t> position(0, outer-1);
+            for (int64_t m = count(rng); m > 0; --m){
+                int64_t i;
+                int64_t j;
+                do {
+                    i = position(rng);
+                    j = position(rng);
+                } while (i == j || (i < inner && j < inner));
+                edges.push_back({order[i], order[j], 1.0});
+            }
+        }
+    }
+
+    build_adjacency(network, n, 0, edges, pool);
+    std::vector<int64_t> ids(n);
+    std::iota(ids.begin(), ids.end(), 0);
+    set_vertex_ids(network, ids);
+}
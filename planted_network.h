@@ -0,0 +1,34 @@
+//
+// Synthetic networks with a planted nested core-periphery structure, built in memory
+// for benchmarks.
+//
+// The nodes are split into depth+1 nested levels: level 0 is the whole network and each
+// core l holds the first core_fraction^l of the nodes, in a random order of the vertex
+// indices. Two nodes are joined with probability p_l, where l is the innermost core both
+// are in, and p_l = p_0 density_ratio^l, capped at 1, with p_0 chosen so the average
+// degree comes out as asked. This is the model's own picture of a network whose groups
+// are the cores, so its likelihood is highest near the planted groups.
+//
+
+#ifndef HCP_PLANTED_NETWORK_H
+#define HCP_PLANTED_NETWORK_H
+
+#include "network.h"
+#include "thread_pool.h"
+#include <vector>
+
+struct planted_options {
+    int nodes = 100000;
+    int depth = 3; // cores inside the whole network
+    double degree = 16.0; // average degree
+    double core_fraction = 0.25; // share of each level's nodes in the next core
+    double density_ratio = 4.0; // edge probability of each core relative to the level outside it
+    unsigned long seed = 1;
+};
+
+// Fills network, whose arrays are allocated as free_network expects, and level with the
+// innermost core of every vertex. The adjacency is built on the threads of pool.
+void planted_core_periphery(NETWORK *network, std::vector<int> &level, const planted_options &options,
+                            thread_pool &pool);
+
+#endif //HCP_PLANTED_NETWORK_H
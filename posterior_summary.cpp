@@ -0,0 +1,147 @@
+//
+// Summaries of the posterior gathered as a chain runs.
+//
+
+#include "posterior_summary.h"
+#include "checkpoint.h"
+#include <fstream>
+
+posterior_summary::posterior_summary(const NETWORK &network, int max_num_groups, bool neighbours)
+    : G(network), neighbours(neighbours), num_groups_count(max_num_groups+1, 0), marginals(max_num_groups+1),
+      innermost(network.nvertices) {
+    if (neighbours){
+        int64_t edges = 0;
+        for (int u = 0; u < G.nvertices; ++u){
+            for (int64_t e = G.offset[u]; e < G.offset[u+1]; ++e){
+                edges += (u < G.target[e]);
+            }
+        }
+        co_core.assign(edges, 0);
+    }
+}
+
+void posterior_summary::add(hierarchical_model &model) {
+    int K = model.num_groups;
+    samples++;
+    num_groups_count[K]++;
+    double delta = model.loglike - loglike_mean;
+    loglike_mean += delta/samples;
+    loglike_m2 += delta*(model.loglike - loglike_mean);
+
+    model.get_g(groups);
+    int words = model.group_words();
+    std::vector<uint32_t> &counts = marginals[K];
+    if (counts.empty()){
+        counts.assign(static_cast<std::size_t>(G.nvertices)*K, 0);
+    }
+    for (int u = 0; u < G.nvertices; ++u){
+        const uint64_t *state = groups.data() + static_cast<std::size_t>(u)*words;
+        uint32_t *node_counts = counts.data() + static_cast<std::size_t>(u)*K;
+        int top = 0;
+        for (int w = 0; w < words; ++w){
+            for (uint64_t bits = state[w]; bits; bits &= bits-1){
+                int r = 64*w + __builtin_ctzll(bits);
+                node_counts[r]++;
+                top = r;
+            }
+        }
+        innermost[u] = top;
+    }
+
+    if (neighbours){
+        std::size_t idx = 0;
+        for (int u = 0; u < G.nvertices; ++u){
+            for (int64_t e = G.offset[u]; e < G.offset[u+1]; ++e){
+                int v = G.target[e];
+                if (u < v){
+                    co_core[idx++] += (innermost[u] == innermost[v]);
+                }
+            }
+        }
+    }
+}
+
+bool posterior_summary::write(const std::filesystem::path &path) const {
+    std::ofstream out(path);
+    if (!out){
+        std::cerr<<"Unable to open '"<<path.string()<<"'"<<std::endl;
+        return false;
+    }
+    double variance = (samples > 1) ? loglike_m2/(samples-1) : 0.0;
+    out.precision(10);
+    out<<"samples "<<samples<<"\n";
+    out<<"loglike "<<loglike_mean<<" "<<variance<<"\n";
+    // probabilities to 4 digits keep the file small
+    out.precision(4);
+    out<<"num_groups";
+    for (std::size_t K = 0; K < num_groups_count.size(); ++K){
+        if (num_groups_count[K] > 0){
+            out<<" "<<K<<":"<<num_groups_count[K];
+        }
+    }
+    out<<"\n";
+
+    for (std::size_t K = 0; K < marginals.size(); ++K){
+        if (marginals[K].empty()){
+            continue;
+        }
+        double states = num_groups_count[K];
+        out<<"marginals "<<K<<" "<<num_groups_count[K]<<"\n";
+        for (int u = 0; u < G.nvertices; ++u){
+            const uint32_t *node_counts = marginals[K].data() + static_cast<std::size_t>(u)*K;
+            for (std::size_t r = 0; r < K; ++r){
+                out<<(r ? " " : "")<<node_counts[r]/states;
+            }
+            out<<"\n";
+        }
+    }
+
+    if (neighbours){
+        out<<"co_core "<<co_core.size()<<"\n";
+        std::size_t idx = 0;
+        for (int u = 0; u < G.nvertices; ++u){
+            for (int64_t e = G.offset[u]; e < G.offset[u+1]; ++e){
+                int v = G.target[e];
+                if (u < v){
+                    out<<u<<" "<<v<<" "<<((samples > 0) ? co_core[idx]/static_cast<double>(samples) : 0.0)<<"\n";
+                    idx++;
+                }
+            }
+        }
+    }
+    out.close();
+    if (!out){
+        std::cerr<<"Unable to write '"<<path.string()<<"'"<<std::endl;
+        return false;
+    }
+    return true;
+}
+
+void posterior_summary::save_state(std::ostream &out) {
+    write_value(out, static_cast<int64_t>(samples));
+    write_value(out, loglike_mean);
+    write_value(out, loglike_m2);
+    write_vector(out, num_groups_count);
+    for (const auto &counts : marginals){
+        write_vector(out, counts);
+    }
+    write_vector(out, co_core);
+}
+
+bool posterior_summary::load_state(std::istream &in) {
+    int64_t count;
+    std::size_t num_group_sizes = num_groups_count.size();
+    std::size_t edges = co_core.size();
+    if (!read_value(in, count) || !read_value(in, loglike_mean) || !read_value(in, loglike_m2)
+        || !read_vector(in, num_groups_count) || num_groups_count.size() != num_group_sizes){
+        return false;
+    }
+    samples = count;
+    for (std::size_t K = 0; K < marginals.size(); ++K){
+        if (!read_vector(in, marginals[K])
+            || (!marginals[K].empty() && marginals[K].size() != static_cast<std::size_t>(G.nvertices)*K)){
+            return false;
+        }
+    }
+    return read_vector(in, co_core) && co_core.size() == edges;
+}
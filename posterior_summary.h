@@ -0,0 +1,60 @@
+//
+// Summaries of the posterior gathered as a chain runs, so the quantities usually computed
+// from the samples afterwards are available without keeping them.
+//
+// At every kept state the summary counts the state's number of groups, updates the mean
+// and variance of the log-likelihood, and counts the groups every node is in. Groups are
+// only comparable between states with the same number of groups: the hierarchy keeps them
+// in order, but a group added or removed shifts the ones above it. So the counts of each
+// node are kept separately for every number of groups seen, and each marginal is the
+// probability of the node being in a group given that number of groups. This takes 4
+// bytes per node and group for every number of groups the chain visits.
+//
+// Optionally the summary also counts, for every edge, the states in which its ends have
+// the same innermost group, that is share a core. Being in the same core does not depend
+// on how the groups are numbered, so these need no alignment. They take 4 bytes per edge.
+//
+// Written as text:
+//   samples <number of kept states>
+//   loglike <mean> <variance>
+//   num_groups <K>:<states> ...                   for every number of groups seen
+//   marginals <K> <states>                        for every K seen, followed by
+//   <p_0> ... <p_K-1>                             one line per node in index order
+//   co_core <edges>                               with neighbours, followed by
+//   <u> <v> <p>                                   one line per edge with u < v
+//
+
+#ifndef HCP_POSTERIOR_SUMMARY_H
+#define HCP_POSTERIOR_SUMMARY_H
+
+#include "hierarchical_model.h"
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+class posterior_summary {
+    public:
+        const NETWORK &G;
+        bool neighbours; // whether the ends of every edge are compared
+        long long samples = 0;
+        std::vector<long long> num_groups_count; // states with each number of groups
+        double loglike_mean = 0.0;
+        double loglike_m2 = 0.0; // sum of squared deviations from the mean, as in Welford's method
+        // marginals[K] holds how often node u was in group r of a state with K groups at
+        // u*K + r, and is empty until such a state is seen
+        std::vector<std::vector<uint32_t>> marginals;
+        std::vector<uint32_t> co_core; // states in which the ends of each edge u < v share their innermost group
+        std::vector<uint64_t> groups; // scratch space for the state in hierarchy order
+        std::vector<int> innermost; // scratch space for the innermost group of every node
+
+        posterior_summary(const NETWORK &network, int max_num_groups, bool neighbours);
+
+        void add(hierarchical_model &model);
+        bool write(const std::filesystem::path &path) const;
+
+        void save_state(std::ostream &out);
+        bool load_state(std::istream &in);
+};
+
+#endif //HCP_POSTERIOR_SUMMARY_H
@@ -0,0 +1,50 @@
+//
+// Measures how reading a network file scales with the number of threads. The file is
+// parsed with 1, 2, 4, ... threads up to the given maximum, ignoring any graph cache,
+// and the best time of a few repeats is reported for each.
+//
+// usage: hcp_read_scaling <graph> [max threads] [repeats]
+//
+
+#include "graph_formats.h"
+#include "readgml.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 4){
+        std::cerr<<"usage: "<<argv[0]<<" <graph> [max threads] [repeats]"<<std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string path = argv[1];
+    int max_threads = (argc > 2) ? std::stoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+    int repeats = (argc > 3) ? std::stoi(argv[3]) : 3;
+
+    std::vector<int> counts;
+    for (int t = 1; t < max_threads; t *= 2){
+        counts.push_back(t);
+    }
+    counts.push_back(max_threads);
+
+    std::vector<double> best(counts.size());
+    for (std::size_t i = 0; i < counts.size(); ++i){
+        best[i] = 1e300;
+        for (int r = 0; r < repeats; ++r){
+            NETWORK network;
+            auto start = std::chrono::steady_clock::now();
+            parse_graph(&network, path, graph_format::automatic, true, counts[i]);
+            best[i] = std::min(best[i], std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            free_network(&network);
+        }
+    }
+
+    std::cout<<"threads\tseconds\tspeedup"<<std::endl;
+    for (std::size_t i = 0; i < counts.size(); ++i){
+        std::cout<<counts[i]<<"\t"<<best[i]<<"\t"<<best[0]/best[i]<<std::endl;
+    }
+    return 0;
+}
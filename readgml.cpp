@@ -13,432 +13,459 @@
 // the read_network(params) function in this file has been slightly modified for the specific
 // use case of this application, namely the syntax for specifying input file.
 //
+// The file is now memory mapped and read in a single pass by a small tokenizer,
+// instead of being copied into a linked list of lines that was walked four times.
+// Nodes and edges are collected in file order, GML IDs are resolved through a
+// direct-index table (or a hash table when the IDs are sparse), and the network is
+// built straight into compressed sparse row form.  A parsed network can be saved as
+// a binary cache that later runs map without parsing (see graph_cache.h).
+//
+// Large files are split at lines that open a node or edge list and the pieces are
+// parsed on several threads.  Each piece but the first is parsed as if it started
+// inside the graph list; the split is only used if every piece ends where the next
+// one was assumed to start, and the whole file is parsed in one piece otherwise.
+//
 // Function calls:
-//   int read_network(NETWORK *network, string filepath)
+//   int read_network(NETWORK *network, string filepath, int num_threads)
 //     -- Reads a network from the file at filepath into the
-//        structure "network".  For the format of NETWORK structs see file
-//        "network.h".  Returns 0 if read was successful.
+//        structure "network", using up to num_threads threads.  For the
+//        format of NETWORK structs see file "network.h".  Returns 0 if read
+//        was successful.
+//   int read_gml(NETWORK *network, string filepath, int num_threads)
+//     -- Same, but always parses the GML file and ignores any cache.
 //   void free_network(NETWORK *network)
 //     -- Destroys a NETWORK struct again, freeing up the memory
 
 
 // Inclusions
 
+#include <algorithm>
+#include <cstdint>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
 #include <cstdio>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <cstdlib>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "network.h"
+#include "graph_cache.h"
+#include "network_builder.h"
+#include "graph_formats.h"
+#include "thread_pool.h"
 
-// Constants
+// Types
 
-#define LINELENGTH 1000
+typedef enum { TOKEN_END, TOKEN_KEY, TOKEN_NUMBER, TOKEN_STRING, TOKEN_OPEN, TOKEN_CLOSE } TOKEN_KIND;
 
-// Types
+typedef struct {
+    TOKEN_KIND kind;
+    const char *start;   // Text of the token, without quotes for strings
+    const char *stop;
+} TOKEN;
 
-typedef struct line {
-    char *str;
-    struct line *ptr;
-} LINE;
+typedef enum { LIST_OTHER, LIST_GRAPH, LIST_NODE, LIST_EDGE } LIST_KIND;
 
-// Globals
+typedef struct {
+    int id;
+    const char *label;   // Points into the mapped file, NULL if no label specified
+    int label_length;
+} RAW_NODE;
 
-LINE *first;
-LINE *current;
+typedef struct {
+    int source;          // GML IDs, resolved to vertex indices once all nodes are known
+    int target;
+    double weight;
+} RAW_EDGE;
 
 
-// Function to read one line from a specified stream.  Return value is
-// 1 if an EOF was encountered.  Otherwise 0.
+// Characters that end a key or a number
 
-int read_line(FILE *stream, char line[LINELENGTH])
+inline int is_delimiter(char c)
 {
-    if (fgets(line,LINELENGTH,stream)==NULL) return 1;
-    line[strlen(line)-1] = '\0';   // Erase the terminating NEWLINE
-    return 0;
+    return (c==' ')||(c=='\n')||(c=='\t')||(c=='\r')||(c=='[')||(c==']')||(c=='"');
 }
 
 
-// Function to read in the whole file into a linked-list buffer, so that we
-// can do several passes on it, as required to read the GML format
-// efficiently
+// Function to read the next token from the buffer between pos and end.
+// Whitespace and lines starting with '#' are skipped.
 
-int fill_buffer(FILE *stream)
+TOKEN next_token(const char *&pos, const char *end)
 {
-    int length;
-    char line[LINELENGTH];
-    LINE *previous;
-
-    if (read_line(stream,line)!=0) {
-        first = NULL;                // Indicates empty buffer
-        return 1;
+    TOKEN token;
+
+    while (pos<end) {
+        if (*pos=='#') {
+            while ((pos<end)&&(*pos!='\n')) pos++;
+        } else if ((*pos==' ')||(*pos=='\t')||(*pos=='\n')||(*pos=='\r')) {
+            pos++;
+        } else break;
     }
-    length = strlen(line) + 1;
-    first = static_cast<LINE*>(malloc(sizeof(LINE)));
-    first->str = static_cast<char*>(malloc(length*sizeof(char)));
-    strcpy(first->str,line);
-
-    previous = first;
-    while (read_line(stream,line)==0) {
-        length = strlen(line) + 1;
-        previous->ptr = static_cast<LINE*>(malloc(sizeof(LINE)));
-        previous = previous->ptr;
-        previous->str = static_cast<char*>(malloc(length*sizeof(char)));
-        strcpy(previous->str,line);
+    token.start = pos;
+    if (pos==end) {
+        token.kind = TOKEN_END;
+    } else if (*pos=='[') {
+        token.kind = TOKEN_OPEN;
+        pos++;
+    } else if (*pos==']') {
+        token.kind = TOKEN_CLOSE;
+        pos++;
+    } else if (*pos=='"') {
+        token.kind = TOKEN_STRING;
+        token.start = ++pos;
+        while ((pos<end)&&(*pos!='"')) pos++;
+        token.stop = pos;
+        if (pos<end) pos++;
+        return token;
+    } else if ((*pos=='-')||(*pos=='+')||(*pos=='.')||((*pos>='0')&&(*pos<='9'))) {
+        token.kind = TOKEN_NUMBER;
+        while ((pos<end)&&!is_delimiter(*pos)) pos++;
+    } else {
+        token.kind = TOKEN_KEY;
+        while ((pos<end)&&!is_delimiter(*pos)) pos++;
     }
-    previous->ptr = NULL;          // Indicates last line
-
-    return 0;
+    token.stop = pos;
+    return token;
 }
 
 
-// Function to free up the buffer again
-
-void free_buffer()
+int key_is(const TOKEN &token, const char *key)
 {
-    LINE *thisptr;
-    LINE *nextptr;
-
-    thisptr = first;
-    while (thisptr!=NULL) {
-        nextptr = thisptr->ptr;
-        free(thisptr->str);
-        free(thisptr);
-        thisptr = nextptr;
-    }
+    std::size_t length = strlen(key);
+    return (static_cast<std::size_t>(token.stop-token.start)==length)&&(strncmp(token.start,key,length)==0);
 }
 
 
-// Function to reset to the start of the buffer again
-
-void reset_buffer()
+int token_int(const TOKEN &token, int &value)
 {
-    current = first;
+    const char *start = token.start;
+    if ((start<token.stop)&&(*start=='+')) start++;
+    return std::from_chars(start,token.stop,value).ec==std::errc();
 }
 
 
-// Function to get the next line in the buffer.  Returns 0 if there was
-// a line or 1 if we've reached the end of the buffer.
-
-int next_line(char line[LINELENGTH])
+int token_double(const TOKEN &token, double &value)
 {
-    if (current==NULL) return 1;
-    strcpy(line,current->str);
-    current = current->ptr;
-    return 0;
+    const char *start = token.start;
+    if ((start<token.stop)&&(*start=='+')) start++;
+    return std::from_chars(start,token.stop,value).ec==std::errc();
 }
 
 
+// Function to parse the buffer in one pass.  Keeps track of the nesting of lists so
+// that keys are only read inside the graph, node and edge lists they belong to; any
+// other list (graphics and the like) is skipped.  The buffer is taken to start inside
+// the graph list if start_inside is set, and must end inside it if end_inside is set,
+// as the pieces of a split file do.  directed is only changed if the buffer sets it.
+// Returns 0 if the buffer was well formed.
 
-// Function to establish whether the network read from a given stream is
-// directed or not.  Returns 1 for a directed network, and 0 otherwise.  If
-// the GML file contains no "directed" line then the graph is assumed to be
-// undirected, which is the GML default behavior.
-
-int is_directed()
+int parse_gml(const char *pos, const char *end, int start_inside, int end_inside, int &directed,
+              std::vector<RAW_NODE> &nodes, std::vector<RAW_EDGE> &edges)
 {
-    int result=0;
-    char *ptr;
-    char line[LINELENGTH];
+    std::vector<LIST_KIND> lists;
+    RAW_NODE node;
+    RAW_EDGE edge;
+    int has_id = 0, has_source = 0, has_target = 0;
 
-    reset_buffer();
-
-    while (next_line(line)==0) {
-        ptr = strstr(line,"directed");
-        if (ptr==NULL) continue;
-        sscanf(ptr,"directed %i",&result);
-        break;
-    }
-
-    return result;
-}
+    if (start_inside) lists.push_back(LIST_GRAPH);
 
+    while (true) {
+        TOKEN key = next_token(pos,end);
+        if (key.kind==TOKEN_END) break;
 
-// Function to count the vertices in a GML file.  Returns number of vertices.
+        LIST_KIND parent = lists.empty() ? LIST_OTHER : lists.back();
 
-int count_vertices()
-{
-    int result=0;
-    char *nonspace;
-    char line[LINELENGTH];
-
-    reset_buffer();
-
-    while (next_line(line)==0) {
-        for (nonspace=line; *nonspace==' '; nonspace++);
-        if (strncmp(nonspace,"node",4)==0) result++;
+        if (key.kind==TOKEN_CLOSE) {
+            if (lists.empty()) return 1;
+            if ((parent==LIST_NODE)&&has_id) {
+                nodes.push_back(node);
+            } else if ((parent==LIST_EDGE)&&has_source&&has_target) {
+                edges.push_back(edge);
+            }
+            lists.pop_back();
+            continue;
+        }
+        if (key.kind!=TOKEN_KEY) return 1;
+
+        TOKEN value = next_token(pos,end);
+        if (value.kind==TOKEN_OPEN) {
+            int outside = lists.empty()||(parent==LIST_GRAPH);
+            if (lists.empty()&&key_is(key,"graph")) {
+                lists.push_back(LIST_GRAPH);
+            } else if (outside&&key_is(key,"node")) {
+                node.id = 0;
+                node.label = NULL;
+                has_id = 0;
+                lists.push_back(LIST_NODE);
+            } else if (outside&&key_is(key,"edge")) {
+                edge.weight = 1.0;
+                has_source = has_target = 0;
+                lists.push_back(LIST_EDGE);
+            } else {
+                lists.push_back(LIST_OTHER);
+            }
+            continue;
+        }
+        if ((value.kind!=TOKEN_NUMBER)&&(value.kind!=TOKEN_STRING)&&(value.kind!=TOKEN_KEY)) return 1;
+        if ((value.kind==TOKEN_STRING)&&(value.stop==end)) return 1;     // Unterminated string
+
+        if (parent==LIST_GRAPH) {
+            if (key_is(key,"directed")) token_int(value,directed);
+        } else if (parent==LIST_NODE) {
+            if (key_is(key,"id")) {
+                has_id = token_int(value,node.id);
+            } else if (key_is(key,"label")&&(node.label==NULL)) {
+                node.label = value.start;
+                node.label_length = value.stop - value.start;
+            }
+        } else if (parent==LIST_EDGE) {
+            if (key_is(key,"source")) {
+                has_source = token_int(value,edge.source);
+            } else if (key_is(key,"target")) {
+                has_target = token_int(value,edge.target);
+            } else if (key_is(key,"value")) {
+                token_double(value,edge.weight);
+            }
+        }
     }
 
-    return result;
+    if (end_inside) return ((lists.size()==1)&&(lists[0]==LIST_GRAPH)) ? 0 : 1;
+    return lists.empty() ? 0 : 1;
 }
 
 
-// Function to compare the IDs of two vertices
+// Function to choose where to split the buffer into about the given number of
+// pieces: at the start of the first line after each equal share that opens a node
+// or edge list.  Returns the starts of the pieces followed by the end.
 
-int cmpid(VERTEX *v1p, VERTEX *v2p)
+std::vector<const char*> split_gml(const char *text, const char *end, int pieces)
 {
-    if (v1p->id>v2p->id) return 1;
-    if (v1p->id<v2p->id) return -1;
-    return 0;
+    int k;
+    std::vector<const char*> cuts;
+
+    cuts.push_back(text);
+    for (k=1; k<pieces; k++) {
+        const char *pos = std::max(cuts.back(),text+(end-text)/pieces*k);
+        const char *limit = std::min(end,pos+(1<<20));
+        const char *cut = NULL;
+        while ((cut==NULL)&&(pos<limit)) {
+            const char *newline = static_cast<const char*>(memchr(pos,'\n',limit-pos));
+            if (newline==NULL) break;
+            pos = newline + 1;
+            const char *p = pos;
+            while ((p<end)&&((*p==' ')||(*p=='\t'))) p++;
+            if ((end-p<4)||((strncmp(p,"node",4)!=0)&&(strncmp(p,"edge",4)!=0))) continue;
+            p += 4;
+            while ((p<end)&&((*p==' ')||(*p=='\t')||(*p=='\r')||(*p=='\n'))) p++;
+            if ((p<end)&&(*p=='[')) cut = pos;
+        }
+        if ((cut!=NULL)&&(cut>cuts.back())) cuts.push_back(cut);
+    }
+    cuts.push_back(end);
+
+    return cuts;
 }
 
 
-// Function to allocate space for a network structure stored in a GML file
-// and determine the parameters (id, label) of each of the vertices.
+// Function to build the NETWORK from the parsed nodes and the edges of every piece.
+// Vertices are sorted in increasing order of their IDs as before, and the edges are
+// resolved on the threads of the pool.  Returns 0 if every edge refers to a known
+// node, and sets dropped to the number of self-loops and repeated edges left out.
 
-void create_network(NETWORK *network)
+int build_network(NETWORK *network, int directed, std::vector<RAW_NODE> &nodes,
+                  std::vector<std::vector<RAW_EDGE>> &edges, thread_pool &pool, int64_t &dropped)
 {
     int i;
-    int length;
-    char *ptr;
-    char *start,*stop;
-    char *nonspace;
-    char line[LINELENGTH];
-    char label[LINELENGTH];
-
-    // Determine whether the network is directed
-
-    network->directed = is_directed();
-
-    // Count the vertices
-
-    network->nvertices = count_vertices();
-
-    // Make space for the vertices
-
-    network->vertex = static_cast<VERTEX*>(calloc(network->nvertices,sizeof(VERTEX)));
-
-    // Go through the file reading the details of each vertex one by one
-
-    reset_buffer();
-    for (i=0; i<network->nvertices; i++) {
-
-        // Skip to next "node" entry.  Check that the start of the line is "node"
-        // explicitly, to avoid other lines that might contain "node"
-
-        do {
-            next_line(line);
-            for (nonspace=line; *nonspace==' '; nonspace++);
-        } while (strncmp(nonspace,"node",4)!=0);
-
-        // Read in the details of this vertex
-
-        do {
-
-            // Skip leading spaces
-
-            for (nonspace=line; *nonspace==' '; nonspace++);
-
-            // Look for ID
-
-            if (strncmp(nonspace,"id",2)==0) {
-                sscanf(nonspace,"id %i",&network->vertex[i].id);
+    int n = nodes.size();
+    std::size_t p, pieces = edges.size();
+
+    std::stable_sort(nodes.begin(),nodes.end(),
+                     [](const RAW_NODE &a, const RAW_NODE &b){ return a.id<b.id; });
+
+    std::vector<int64_t> ids(n);
+    for (i=0; i<n; i++) ids[i] = nodes[i].id;
+    id_index index(ids);
+
+    std::vector<std::size_t> first(pieces+1,0);
+    for (p=0; p<pieces; p++) first[p+1] = first[p] + edges[p].size();
+    std::vector<index_edge> resolved(first[pieces]);
+    std::vector<std::size_t> missing(pieces,SIZE_MAX);
+    for (p=0; p<pieces; p++) {
+        pool.submit([&,p]() {
+            for (std::size_t e=0; e<edges[p].size(); e++) {
+                index_edge &out = resolved[first[p]+e];
+                out.source = index.find(edges[p][e].source);
+                out.target = index.find(edges[p][e].target);
+                out.weight = edges[p][e].weight;
+                if (((out.source<0)||(out.target<0))&&(missing[p]==SIZE_MAX)) missing[p] = e;
             }
-
-            // Look for label
-
-            if (strncmp(nonspace,"label",5)==0) {
-                start = strchr(line,'"');
-                if (start==NULL) {
-                    sscanf(nonspace,"label %s",&label);
-                } else {
-                    stop = strchr(++start,'"');
-                    if (stop==NULL) length = strlen(line) - (start-line);
-                    else length = stop - start;
-                    strncpy(label,start,length);
-                    label[length] = '\0';
-                    network->vertex[i].label = static_cast<char*>(malloc((length+1)*sizeof(char)));
-                    strcpy(network->vertex[i].label,label);
-                }
-            }
-
-            // If we see a closing square bracket we are done
-
-            if (strstr(line,"]")!=NULL) break;
-
-        } while (next_line(line)==0);
-
+        });
     }
+    pool.wait();
+    for (p=0; p<pieces; p++) {
+        if (missing[p]==SIZE_MAX) continue;
+        fprintf(stderr,"Edge %d -- %d refers to a node that does not exist\n",
+                edges[p][missing[p]].source,edges[p][missing[p]].target);
+        return 1;
+    }
+    dropped = build_adjacency(network,n,directed,resolved,pool);
 
-    // Sort the vertices in increasing order of their IDs so we can find them
-    // quickly later
-
-    std::qsort(network->vertex,network->nvertices,sizeof(VERTEX), (int(*)(const void*, const void*))cmpid);
-}
-
+    // Copy the labels, which still point into the file, into one block
 
-// Function to find a vertex with a specified ID using binary search.
-// Returns the element in the vertex[] array holding the vertex in question,
-// or -1 if no vertex was found.
+    network->id = static_cast<int64_t*>(malloc(n*sizeof(int64_t)));
+    network->label_offset = static_cast<int64_t*>(malloc(n*sizeof(int64_t)));
+    int64_t label_bytes = 0;
+    for (i=0; i<n; i++) {
+        network->id[i] = nodes[i].id;
+        network->label_offset[i] = (nodes[i].label==NULL) ? -1 : label_bytes;
+        if (nodes[i].label!=NULL) label_bytes += nodes[i].label_length + 1;
+    }
+    network->label_data = static_cast<char*>(malloc(label_bytes));
+    for (i=0; i<n; i++) {
+        if (nodes[i].label==NULL) continue;
+        memcpy(network->label_data+network->label_offset[i],nodes[i].label,nodes[i].label_length);
+        network->label_data[network->label_offset[i]+nodes[i].label_length] = '\0';
+    }
 
-int find_vertex(int id, NETWORK *network)
-{
-    int top,bottom,split;
-    int idsplit;
-
-    top = network->nvertices;
-    if (top<1) return -1;
-    bottom = 0;
-    split = top/2;
-
-    do {
-        idsplit = network->vertex[split].id;
-        if (id>idsplit) {
-            bottom = split + 1;
-            split = (top+bottom)/2;
-        } else if (id<idsplit) {
-            top = split;
-            split = (top+bottom)/2;
-        } else return split;
-    } while (top>bottom);
-
-    return -1;
+    return 0;
 }
 
 
-// Function to determine the degrees of all the vertices by going through
-// the edge data
+// Function to parse a complete network from a GML file
 
-void get_degrees(NETWORK *network)
+int read_gml(NETWORK *network, std::string filepath, int num_threads)
 {
-    int s,t;
-    int vs,vt;
-    char *ptr;
-    char line[LINELENGTH];
-
-    reset_buffer();
-
-    while (next_line(line)==0) {
-
-        // Find the next edge entry
-
-        ptr = strstr(line,"edge");
-        if (ptr==NULL) continue;
-
-        // Read the source and target of the edge
-
-        s = t = -1;
-
-        do {
-
-            ptr = strstr(line,"source");
-            if (ptr!=NULL) sscanf(ptr,"source %i",&s);
-            ptr = strstr(line,"target");
-            if (ptr!=NULL) sscanf(ptr,"target %i",&t);
-
-            // If we see a closing square bracket we are done
-
-            if (strstr(line,"]")!=NULL) break;
-
-        } while (next_line(line)==0);
-
-        // Increment the degrees of the appropriate vertex or vertices
+    int i;
+    auto start = std::chrono::steady_clock::now();
 
-        if ((s>=0)&&(t>=0)) {
-            vs = find_vertex(s,network);
-            network->vertex[vs].degree++;
-            if (network->directed==0) {
-                vt = find_vertex(t,network);
-                network->vertex[vt].degree++;
-            }
+    int fd = open(filepath.c_str(),O_RDONLY);
+    struct stat info;
+    if ((fd<0)||(fstat(fd,&info)!=0)) {
+        fprintf(stderr, "Unable to open '%s': %s\n",
+                filepath.c_str(), strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    std::size_t size = info.st_size;
+    const char *data = NULL;
+    if (size>0) {
+        void *map = mmap(NULL,size,PROT_READ,MAP_PRIVATE,fd,0);
+        if (map==MAP_FAILED) {
+            fprintf(stderr, "Unable to map '%s': %s\n",
+                    filepath.c_str(), strerror(errno));
+            exit(EXIT_FAILURE);
         }
-
+        madvise(map,size,MADV_SEQUENTIAL);
+        data = static_cast<const char*>(map);
     }
-
-    return;
-}
-
-
-// Function to read in the edges
-
-void read_edges(NETWORK *network)
-{
-    int i;
-    int s,t;
-    int vs,vt;
-    int *count;
-    double w;
-    char *ptr;
-    char line[LINELENGTH];
-
-    // Malloc space for the edges and temporary space for the edge counts
-    // at each vertex
-
-    for (i=0; i<network->nvertices; i++) {
-        network->vertex[i].edge = static_cast<EDGE*>(malloc(network->vertex[i].degree*sizeof(EDGE)));
+    close(fd);
+
+    // A compressed file is decompressed into memory first, since the parser needs
+    // the whole text
+
+    const char *text = data;
+    std::size_t text_size = size;
+    std::vector<char> decompressed;
+    if (is_compressed(data,size)) {
+        std::unique_ptr<input_stream> stream = open_input_stream(filepath);
+        std::vector<char> chunk(1<<20);
+        long n;
+        while ((stream!=nullptr)&&((n = stream->read(chunk.data(),chunk.size()))>0)) {
+            decompressed.insert(decompressed.end(),chunk.data(),chunk.data()+n);
+        }
+        if ((stream==nullptr)||(n<0)) {
+            fprintf(stderr, "Unable to decompress '%s'\n", filepath.c_str());
+            exit(EXIT_FAILURE);
+        }
+        text = decompressed.data();
+        text_size = decompressed.size();
     }
-    count = static_cast<int *>(calloc(network->nvertices,sizeof(int)));
-
-    // Read in the data
-
-    reset_buffer();
-
-    while (next_line(line)==0) {
-
-        // Find the next edge entry
-
-        ptr = strstr(line,"edge");
-        if (ptr==NULL) continue;
-
-        // Read the source and target of the edge and the edge weight
 
-        s = t = -1;
-        w = 1.0;
-
-        do {
-
-            ptr = strstr(line,"source");
-            if (ptr!=NULL) sscanf(ptr,"source %i",&s);
-            ptr = strstr(line,"target");
-            if (ptr!=NULL) sscanf(ptr,"target %i",&t);
-            ptr = strstr(line,"value");
-            if (ptr!=NULL) sscanf(ptr,"value %lf",&w);
-
-            // If we see a closing square bracket we are done
-
-            if (strstr(line,"]")!=NULL) break;
-
-        } while (next_line(line)==0);
+    // Parse the pieces in parallel, and the whole text at once if the split does not
+    // hold up.  Small files are not worth splitting.
+
+    thread_pool pool(num_threads);
+    int pieces = std::min<std::size_t>(4*num_threads,text_size/(1<<20)+1);
+    std::vector<const char*> cuts = split_gml(text,text+text_size,pieces);
+    pieces = cuts.size() - 1;
+    std::vector<int> directed(pieces,-1);
+    std::vector<std::vector<RAW_NODE>> nodes(pieces);
+    std::vector<std::vector<RAW_EDGE>> edges(pieces);
+    std::vector<int> status(pieces,0);
+    for (i=0; i<pieces; i++) {
+        pool.submit([&,i]() {
+            edges[i].reserve((cuts[i+1]-cuts[i])/64);
+            status[i] = parse_gml(cuts[i],cuts[i+1],i>0,i<pieces-1,directed[i],nodes[i],edges[i]);
+        });
+    }
+    pool.wait();
+    if (std::count(status.begin(),status.end(),0)!=pieces) {
+        pieces = 1;
+        directed.assign(1,-1);
+        nodes.assign(1,std::vector<RAW_NODE>());
+        edges.assign(1,std::vector<RAW_EDGE>());
+        if (parse_gml(text,text+text_size,0,0,directed[0],nodes[0],edges[0])!=0) {
+            fprintf(stderr, "Unable to parse '%s': unbalanced brackets or a key without a value\n",
+                    filepath.c_str());
+            exit(EXIT_FAILURE);
+        }
+    }
 
-        // Add these edges to the appropriate vertices
+    // The last directed key in the file counts, and the nodes are kept in file order
 
-        if ((s>=0)&&(t>=0)) {
-            vs = find_vertex(s,network);
-            vt = find_vertex(t,network);
-            network->vertex[vs].edge[count[vs]].target = vt;
-            network->vertex[vs].edge[count[vs]].weight = w;
-            count[vs]++;
-            if (network->directed==0) {
-                network->vertex[vt].edge[count[vt]].target = vs;
-                network->vertex[vt].edge[count[vt]].weight = w;
-                count[vt]++;
-            }
-        }
+    int is_directed = 0;
+    std::vector<RAW_NODE> all_nodes;
+    std::size_t nedges = 0;
+    for (i=0; i<pieces; i++) {
+        if (directed[i]>=0) is_directed = directed[i];
+        all_nodes.insert(all_nodes.end(),nodes[i].begin(),nodes[i].end());
+        nedges += edges[i].size();
+    }
 
+    // the labels still point into the file, so it stays mapped until the network is built
+    int64_t dropped = 0;
+    int failed = build_network(network,is_directed,all_nodes,edges,pool,dropped);
+    if (size>0) munmap(const_cast<char*>(data),size);
+    if (failed) {
+        exit(EXIT_FAILURE);
     }
 
-    free(count);
-    return;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout<<"read "<<network->nvertices<<" nodes and "<<nedges-dropped<<" edges in "<<seconds<<" s ("
+             <<text_size/1e6/seconds<<" MB/s)";
+    if (dropped>0) std::cout<<", dropping "<<dropped<<" self-loops and repeated edges";
+    std::cout<<std::endl;
+
+    return 0;
 }
 
 
-// Function to read a complete network
+// Function to read a complete network.  A binary cache (see graph_cache.h) is mapped
+// instead of parsing when filepath is a cache itself, or when a cache made from the
+// current version of the GML file sits next to it.
 
-int read_network(NETWORK *network, std::string filepath)
+int read_network(NETWORK *network, std::string filepath, int num_threads)
 {
-    FILE* stream;
-    stream = fopen(filepath.c_str(),"r");
-    if (NULL == stream) {
-        fprintf(stderr, "Unable to open '%s': %s\n",
-                filepath.c_str(), strerror(errno));
-        exit(EXIT_FAILURE);
+    if (is_graph_cache(filepath)) {
+        auto start = std::chrono::steady_clock::now();
+        if (!map_graph_cache(network,filepath,NULL)) {
+            fprintf(stderr, "Unable to map the graph cache '%s'\n", filepath.c_str());
+            exit(EXIT_FAILURE);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout<<"mapped "<<network->nvertices<<" nodes and "<<network->offset[network->nvertices]
+                 <<" adjacency entries from "<<filepath<<" in "<<seconds<<" s"<<std::endl;
+        return 0;
     }
-    fill_buffer(stream);
-    create_network(network);
-    get_degrees(network);
-    read_edges(network);
-    free_buffer();
+    if (map_sidecar_cache(network,filepath,graph_format::gml,true)) return 0;
 
-    return 0;
+    return read_gml(network,filepath,num_threads);
 }
 
 
@@ -446,11 +473,14 @@ int read_network(NETWORK *network, std::string filepath)
 
 void free_network(NETWORK *network)
 {
-    int i;
-
-    for (i=0; i<network->nvertices; i++) {
-        free(network->vertex[i].edge);
-        free(network->vertex[i].label);
+    if (network->mapping!=NULL) {
+        munmap(network->mapping,network->mapping_size);
+        return;
     }
-    free(network->vertex);
-}
\ No newline at end of file
+    free(network->label_offset);
+    free(network->label_data);
+    free(network->id);
+    free(network->offset);
+    free(network->target);
+    free(network->weight);
+}
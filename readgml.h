@@ -7,9 +7,11 @@
 #define HCP_READGML_H
 
 #include <cstdio>
+#include <string>
 #include "network.h"
 
-int read_network(NETWORK *network, std::string filepath);
+int read_network(NETWORK *network, std::string filepath, int num_threads);
+int read_gml(NETWORK *network, std::string filepath, int num_threads);
 void free_network(NETWORK *network);
 
 #endif //HCP_READGML_H
@@ -0,0 +1,155 @@
+//
+// Parallel tempering: several copies of the model run at different temperatures and
+// neighbouring temperatures periodically propose to exchange their states.
+//
+
+#include "replica_exchange.h"
+#include "checkpoint.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+replica_exchange::replica_exchange(int id, const parameters &params, const NETWORK &network, unsigned long seed)
+    : id(id), num_itrs(params.get_max_itr()), swap_interval(params.get_swap_interval()) {
+    for (double t : params.get_temperatures()){
+        betas.push_back(1.0/t);
+    }
+    int n_rungs = betas.size();
+    for (int k = 0; k < n_rungs; ++k){
+        replicas.push_back(std::make_unique<chain>(k, params, network, seed + k));
+        replicas.back()->ensemble = id;
+        rung_replica.push_back(k);
+    }
+    swap_attempts.assign(std::max(n_rungs-1, 0), 0);
+    swap_accepts.assign(std::max(n_rungs-1, 0), 0);
+
+    rng = gsl_rng_alloc(gsl_rng_mt19937);
+    gsl_rng_set(rng, seed + n_rungs);
+
+    assign_rungs();
+}
+
+replica_exchange::~replica_exchange() {
+    gsl_rng_free(rng);
+}
+
+// Gives every replica the temperature of its rung. Only the replica at rung 0 keeps
+// samples, and it reports progress for the first ensemble.
+void replica_exchange::assign_rungs() {
+    for (std::size_t k = 0; k < rung_replica.size(); ++k){
+        chain &replica = *replicas[rung_replica[k]];
+        replica.model->beta = betas[k];
+        replica.samples = (k == 0) ? &samples : nullptr;
+        replica.report_progress = (k == 0 && id == 0);
+    }
+}
+
+void replica_exchange::submit_steps(thread_pool &pool, long end) {
+    for (auto &replica : replicas){
+        chain *c = replica.get();
+        pool.submit([c, end]{ c->run_steps(end); });
+    }
+}
+
+long replica_exchange::position() {
+    long itr = num_itrs;
+    for (auto &replica : replicas){
+        itr = std::min(itr, replica->itr);
+    }
+    return itr;
+}
+
+void replica_exchange::propose_swaps() {
+    for (std::size_t k = swap_round%2; k+1 < rung_replica.size(); k += 2){
+        hierarchical_model &lower = *replicas[rung_replica[k]]->model;
+        hierarchical_model &upper = *replicas[rung_replica[k+1]]->model;
+        double log_ratio = (betas[k] - betas[k+1])*(upper.loglike - lower.loglike);
+        swap_attempts[k]++;
+        if (gsl_rng_uniform(rng) < exp(log_ratio)){
+            std::swap(rung_replica[k], rung_replica[k+1]);
+            swap_accepts[k]++;
+        }
+    }
+    swap_round++;
+    assign_rungs();
+}
+
+hierarchical_model &replica_exchange::cold_model() {
+    return *replicas[rung_replica[0]]->model;
+}
+
+void replica_exchange::print_swap_rates() {
+    std::cout<<"ensemble "<<id<<" swap acceptance:";
+    for (std::size_t k = 0; k < swap_attempts.size(); ++k){
+        double rate = swap_attempts[k] ? static_cast<double>(swap_accepts[k])/swap_attempts[k] : 0.0;
+        std::cout<<" "<<rate;
+    }
+    std::cout<<std::endl;
+}
+
+// Replicas at a different temperature are stored with their rung, so the swap stream
+// and the rung assignment continue exactly where they were.
+void replica_exchange::save_state(std::ostream &out) {
+    write_value(out, static_cast<int64_t>(swap_round));
+    write_vector(out, rung_replica);
+    write_vector(out, swap_attempts);
+    write_vector(out, swap_accepts);
+    write_rng(out, rng);
+    samples.save_state(out);
+    for (auto &replica : replicas){
+        replica->save_state(out);
+    }
+}
+
+bool replica_exchange::load_state(std::istream &in) {
+    int64_t round;
+    std::size_t n_rungs = replicas.size();
+    if (!read_value(in, round) || !read_vector(in, rung_replica) || rung_replica.size() != n_rungs
+        || !read_vector(in, swap_attempts) || !read_vector(in, swap_accepts)
+        || !read_rng(in, rng) || !samples.load_state(in)){
+        return false;
+    }
+    for (auto &replica : replicas){
+        if (!replica->load_state(in)){
+            return false;
+        }
+    }
+    swap_round = round;
+    assign_rungs();
+    return true;
+}
+
+void run_replica_exchange(std::vector<std::unique_ptr<replica_exchange>> &ensembles, thread_pool &pool, long end) {
+    if (ensembles.empty()){
+        return;
+    }
+    long num_itrs = ensembles[0]->num_itrs;
+    long interval = ensembles[0]->swap_interval;
+    end = std::min(end, num_itrs);
+    long itr = ensembles[0]->position();
+    for (auto &ensemble : ensembles){
+        itr = std::min(itr, ensemble->position());
+    }
+    while (itr < end && !stop_requested()){
+        // swaps happen at multiples of the interval and at the very end, wherever the
+        // run was split
+        long swap_at = std::min((itr/interval + 1)*interval, num_itrs);
+        long stop = std::min(swap_at, end);
+        std::vector<long> before;
+        for (auto &ensemble : ensembles){
+            before.push_back(ensemble->position());
+            ensemble->submit_steps(pool, stop);
+        }
+        pool.wait();
+        // an ensemble that already reached swap_at before a restart has made its swaps
+        for (std::size_t c = 0; c < ensembles.size(); ++c){
+            if (before[c] < swap_at && ensembles[c]->position() == swap_at){
+                ensembles[c]->propose_swaps();
+            }
+        }
+        itr = stop;
+        for (auto &ensemble : ensembles){
+            itr = std::min(itr, ensemble->position());
+        }
+    }
+}
@@ -0,0 +1,56 @@
+//
+// Parallel tempering: several copies of the model run at different temperatures and
+// neighbouring temperatures periodically propose to exchange their states.
+//
+
+#ifndef HCP_REPLICA_EXCHANGE_H
+#define HCP_REPLICA_EXCHANGE_H
+
+#include "chain.h"
+#include "parameters.h"
+#include "thread_pool.h"
+#include <gsl/gsl_rng.h>
+#include <memory>
+#include <vector>
+
+class replica_exchange {
+    public:
+        int id;
+        long num_itrs;
+        long swap_interval; // iterations every replica runs between swap proposals
+        std::vector<double> betas; // inverse temperature of each rung, rung 0 samples the posterior
+        std::vector<std::unique_ptr<chain>> replicas;
+        std::vector<int> rung_replica; // replica currently at each rung
+        std::vector<long> swap_attempts; // proposals between rung k and k+1
+        std::vector<long> swap_accepts;
+        sample_store samples; // states kept while at rung 0
+        gsl_rng *rng; // used only for the swap decisions
+        long swap_round = 0;
+
+        // seeds seed .. seed+K-1 go to the replicas and seed+K to the swap decisions
+        replica_exchange(int id, const parameters &params, const NETWORK &network, unsigned long seed);
+        ~replica_exchange();
+        replica_exchange(const replica_exchange&) = delete;
+        replica_exchange& operator=(const replica_exchange&) = delete;
+
+        // queues the iterations of every replica up to end on the pool
+        void submit_steps(thread_pool &pool, long end);
+        // the iteration every replica has reached; replicas only differ after a stop
+        long position();
+        // proposes exchanges between neighbouring rungs, alternating even and odd pairs
+        void propose_swaps();
+        void assign_rungs();
+
+        hierarchical_model &cold_model();
+        void print_swap_rates();
+
+        void save_state(std::ostream &out);
+        bool load_state(std::istream &in);
+};
+
+// Runs the ensembles in lockstep up to iteration end, or until a stop is requested:
+// every replica advances to the next multiple of swap_interval in parallel, then each
+// ensemble proposes its swaps.
+void run_replica_exchange(std::vector<std::unique_ptr<replica_exchange>> &ensembles, thread_pool &pool, long end);
+
+#endif //HCP_REPLICA_EXCHANGE_H
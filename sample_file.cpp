@@ -0,0 +1,344 @@
+//
+// Binary sample files written by a background thread, and reading them back.
+//
+
+#include "sample_file.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+    const char FILE_MAGIC[8] = {'H','C','P','S','M','P','L','1'};
+    const uint32_t FILE_VERSION = 1;
+    const uint32_t HEADER_BYTES = 32;
+    const uint32_t CHUNK_MAGIC = 0x4B4E4843; // "CHNK"
+    const std::size_t MAX_QUEUE_RECORDS = 256;
+    const std::size_t MIN_QUEUE_RECORDS = 2;
+    const std::size_t MAX_CHUNK_RECORDS = 64;
+
+    // how many records of record_bytes fit in budget, between least and most
+    std::size_t records_within(std::size_t budget, std::size_t record_bytes, std::size_t least, std::size_t most) {
+        return std::clamp(budget/std::max<std::size_t>(record_bytes, 1), least, most);
+    }
+
+    template <typename T>
+    void append(std::vector<unsigned char> &buf, const T &value) {
+        const unsigned char *p = reinterpret_cast<const unsigned char*>(&value);
+        buf.insert(buf.end(), p, p + sizeof(T));
+    }
+
+    template <typename T>
+    T extract(const std::vector<unsigned char> &buf, std::size_t &pos) {
+        T value;
+        std::memcpy(&value, buf.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+}
+
+std::string decimal_groups(const uint64_t *words, std::size_t size) {
+    if (size == 1){
+        return std::to_string(words[0]);
+    }
+    std::vector<uint64_t> number(words, words + size);
+    std::string digits;
+    bool zero = false;
+    while (!zero){
+        // divide by 10^19, the largest power of ten in a word, and prepend the remainder
+        const uint64_t base = 10000000000000000000ULL;
+        unsigned __int128 remainder = 0;
+        zero = true;
+        for (std::size_t w = size; w-- > 0;){
+            unsigned __int128 value = (remainder<<64) | number[w];
+            number[w] = static_cast<uint64_t>(value/base);
+            remainder = value%base;
+            zero = zero && number[w] == 0;
+        }
+        std::string part = std::to_string(static_cast<uint64_t>(remainder));
+        if (!zero){
+            part.insert(0, 19 - part.size(), '0');
+        }
+        digits.insert(0, part);
+    }
+    return digits;
+}
+
+sample_writer::sample_writer(const std::filesystem::path &path, std::size_t num_nodes, int max_num_groups,
+                             uint64_t resume_offset, std::size_t queue_bytes, std::size_t chunk_bytes)
+    : _num_nodes(num_nodes),
+      _records_per_chunk(records_within(chunk_bytes, num_nodes*((max_num_groups+7)/8), 1, MAX_CHUNK_RECORDS)),
+      _queue(records_within(queue_bytes, num_nodes*8*((max_num_groups+63)/64), MIN_QUEUE_RECORDS,
+                            MAX_QUEUE_RECORDS)),
+      _chunk_records(0), _closing(false), _flush_requests(0), _flushes_done(0), _offset(0), _path(path.string()),
+      _write_failed(false) {
+    if (resume_offset > 0){
+        std::error_code error;
+        uint64_t size = std::filesystem::file_size(path, error);
+        if (error || size < resume_offset){
+            std::cerr<<"Sample file '"<<path.string()<<"' is shorter than its checkpoint"<<std::endl;
+            exit(EXIT_FAILURE);
+        }
+        std::filesystem::resize_file(path, resume_offset);
+        _file = std::fopen(path.c_str(), "ab");
+    }else{
+        _file = std::fopen(path.c_str(), "wb");
+    }
+    if (_file == NULL){
+        std::cerr<<"Unable to open '"<<path.string()<<"' for writing samples"<<std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (resume_offset > 0){
+        _offset = resume_offset;
+    }else{
+        std::vector<unsigned char> header;
+        header.insert(header.end(), FILE_MAGIC, FILE_MAGIC + 8);
+        append(header, FILE_VERSION);
+        append(header, HEADER_BYTES);
+        append(header, static_cast<uint64_t>(num_nodes));
+        append(header, static_cast<uint64_t>(0));
+        if (std::fwrite(header.data(), 1, header.size(), _file) != header.size()){
+            std::cerr<<"Unable to write samples to '"<<_path<<"'"<<std::endl;
+            exit(EXIT_FAILURE);
+        }
+        _offset = header.size();
+    }
+
+    _thread = std::thread(&sample_writer::work, this);
+}
+
+sample_writer::~sample_writer() {
+    close();
+}
+
+sample_record &sample_writer::acquire() {
+    sample_record *record;
+    // the queue only fills up if the disk cannot keep pace, in which case the sampler waits
+    while ((record = _queue.acquire()) == nullptr){
+        std::this_thread::yield();
+    }
+    return *record;
+}
+
+void sample_writer::publish() {
+    _queue.publish();
+}
+
+uint64_t sample_writer::flush() {
+    long request = ++_flush_requests;
+    while (_flushes_done.load(std::memory_order_acquire) < request){
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    return _offset.load(std::memory_order_acquire);
+}
+
+bool sample_writer::close() {
+    if (_thread.joinable()){
+        _closing = true;
+        _thread.join();
+        _write_failed |= (std::fclose(_file) != 0);
+        if (_write_failed){
+            std::cerr<<"Unable to write samples to '"<<_path<<"'; the file ends at the last chunk written in full"
+                     <<std::endl;
+        }
+    }
+    return !_write_failed;
+}
+
+void sample_writer::work() {
+    while (true){
+        // read the requests before looking at the queue, so anything pushed before a
+        // request is seen and written first
+        long request = _flush_requests.load(std::memory_order_acquire);
+        bool closing = _closing.load(std::memory_order_acquire);
+
+        if (sample_record *record = _queue.front()){
+            encode(*record);
+            _queue.pop();
+            if (_chunk_records == _records_per_chunk){
+                write_chunk();
+            }
+            continue;
+        }
+        if (request != _flushes_done.load(std::memory_order_relaxed)){
+            write_chunk();
+            _write_failed |= (std::fflush(_file) != 0);
+            _flushes_done.store(request, std::memory_order_release);
+            continue;
+        }
+        if (closing){
+            write_chunk();
+            _write_failed |= (std::fflush(_file) != 0);
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void sample_writer::encode(const sample_record &record) {
+    uint32_t state_bytes = (record.num_groups + 7)/8;
+    append(_chunk, static_cast<int64_t>(record.itr));
+    append(_chunk, record.loglike);
+    append(_chunk, static_cast<uint32_t>(record.num_groups));
+    append(_chunk, state_bytes);
+    for (const auto *values : {&record.group_size, &record.hcg_edges, &record.hcg_pairs}){
+        for (int q = 0; q < record.num_groups; ++q){
+            append(_chunk, static_cast<int64_t>((*values)[q]));
+        }
+    }
+    std::size_t words = (record.num_groups + 63)/64;
+    for (std::size_t u = 0; u < _num_nodes; ++u){
+        const uint64_t *state = record.g.data() + u*words;
+        for (uint32_t b = 0; b < state_bytes; ++b){
+            _chunk.push_back(static_cast<unsigned char>(state[b/8]>>(8*(b%8))));
+        }
+    }
+    _chunk_records++;
+}
+
+void sample_writer::write_chunk() {
+    if (_chunk_records == 0){
+        return;
+    }
+    std::vector<unsigned char> header;
+    append(header, CHUNK_MAGIC);
+    append(header, static_cast<uint32_t>(_chunk_records));
+    append(header, static_cast<uint64_t>(_chunk.size()));
+    // after a failed write the file may end in part of a chunk, which readers stop at, so
+    // later chunks are dropped rather than written after it
+    if (!_write_failed){
+        _write_failed = std::fwrite(header.data(), 1, header.size(), _file) != header.size()
+                        || std::fwrite(_chunk.data(), 1, _chunk.size(), _file) != _chunk.size();
+        if (!_write_failed){
+            _offset.fetch_add(header.size() + _chunk.size(), std::memory_order_release);
+        }
+    }
+    _chunk.clear();
+    _chunk_records = 0;
+}
+
+sample_reader::sample_reader(const std::filesystem::path &path)
+    : _num_nodes(0), _pos(0), _records_left(0) {
+    _file = std::fopen(path.c_str(), "rb");
+    if (_file == NULL){
+        return;
+    }
+    std::vector<unsigned char> header(HEADER_BYTES);
+    if (std::fread(header.data(), 1, HEADER_BYTES, _file) != HEADER_BYTES
+        || std::memcmp(header.data(), FILE_MAGIC, 8) != 0){
+        std::fclose(_file);
+        _file = NULL;
+        return;
+    }
+    std::size_t pos = 8;
+    uint32_t version = extract<uint32_t>(header, pos);
+    uint32_t header_bytes = extract<uint32_t>(header, pos);
+    _num_nodes = extract<uint64_t>(header, pos);
+    if (version != FILE_VERSION){
+        std::fclose(_file);
+        _file = NULL;
+        return;
+    }
+    std::fseek(_file, header_bytes, SEEK_SET);
+}
+
+sample_reader::~sample_reader() {
+    if (_file != NULL){
+        std::fclose(_file);
+    }
+}
+
+bool sample_reader::good() const {
+    return _file != NULL;
+}
+
+std::size_t sample_reader::num_nodes() const {
+    return _num_nodes;
+}
+
+bool sample_reader::next_chunk() {
+    std::vector<unsigned char> header(16);
+    if (_file == NULL || std::fread(header.data(), 1, header.size(), _file) != header.size()){
+        return false;
+    }
+    std::size_t pos = 0;
+    if (extract<uint32_t>(header, pos) != CHUNK_MAGIC){
+        return false;
+    }
+    _records_left = extract<uint32_t>(header, pos);
+    uint64_t payload = extract<uint64_t>(header, pos);
+    _chunk.resize(payload);
+    if (std::fread(_chunk.data(), 1, payload, _file) != payload){
+        // a chunk cut short by a crash
+        _records_left = 0;
+        return false;
+    }
+    _pos = 0;
+    return true;
+}
+
+bool sample_reader::next(sample_record &record) {
+    while (_records_left == 0){
+        if (!next_chunk()){
+            return false;
+        }
+    }
+    record.itr = extract<int64_t>(_chunk, _pos);
+    record.loglike = extract<double>(_chunk, _pos);
+    record.num_groups = extract<uint32_t>(_chunk, _pos);
+    uint32_t state_bytes = extract<uint32_t>(_chunk, _pos);
+    for (auto *values : {&record.group_size, &record.hcg_edges, &record.hcg_pairs}){
+        values->resize(record.num_groups);
+        for (int q = 0; q < record.num_groups; ++q){
+            (*values)[q] = extract<int64_t>(_chunk, _pos);
+        }
+    }
+    std::size_t words = (record.num_groups + 63)/64;
+    record.g.assign(_num_nodes*words, 0);
+    for (std::size_t u = 0; u < _num_nodes; ++u){
+        uint64_t *state = record.g.data() + u*words;
+        for (uint32_t b = 0; b < state_bytes; ++b){
+            state[b/8] |= static_cast<uint64_t>(_chunk[_pos++])<<(8*(b%8));
+        }
+    }
+    _records_left--;
+    return true;
+}
+
+bool convert_samples_to_text(const std::filesystem::path &binary_path, const std::filesystem::path &filepath,
+                             const std::string &filename) {
+    sample_reader reader(binary_path);
+    if (!reader.good()){
+        std::cerr<<"Unable to read samples from '"<<binary_path.string()<<"'"<<std::endl;
+        return false;
+    }
+    std::ofstream output_groups(filepath/(filename+"_configs.txt"));
+    std::ofstream output_ngroups(filepath/(filename+"_num_groups.txt"));
+    std::ofstream output_group_size(filepath/(filename+"_group_size.txt"));
+    std::ofstream output_edges(filepath/(filename+"_edges.txt"));
+    std::ofstream output_pairs(filepath/(filename+"_pairs.txt"));
+    std::ofstream output_ll(filepath/(filename+"_ll.txt"));
+
+    sample_record record;
+    while (reader.next(record)){
+        // output decimal representation of groups
+        std::size_t words = (record.num_groups + 63)/64;
+        for (std::size_t u = 0; u < reader.num_nodes(); ++u){
+            output_groups << decimal_groups(record.g.data() + u*words, words) << " ";
+        }
+        output_groups << "\n";
+
+        for (int mu = 0; mu < record.num_groups; ++mu){
+            output_edges << record.hcg_edges[mu] << " ";
+            output_pairs << record.hcg_pairs[mu] << " ";
+            output_group_size << record.group_size[mu] << " ";
+        }
+        output_edges << "\n";
+        output_pairs << "\n";
+        output_group_size << "\n";
+        output_ll << record.loglike << "\n";
+        output_ngroups << record.num_groups << "\n";
+    }
+    return true;
+}
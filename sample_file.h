@@ -0,0 +1,117 @@
+//
+// Binary sample files written by a background thread, and reading them back.
+//
+// Layout (all values little-endian):
+//   file header   char magic[8] = "HCPSMPL1", uint32 version, uint32 header bytes,
+//                 uint64 number of nodes, uint64 reserved
+//   chunk         uint32 magic "CHNK", uint32 number of records, uint64 payload bytes,
+//                 followed by the records
+//   record        int64 iteration, double loglike, uint32 num_groups,
+//                 uint32 bytes per node state, int64 group_size[num_groups],
+//                 int64 hcg_edges[num_groups], int64 hcg_pairs[num_groups],
+//                 node states packed into bytes per node state each
+// Every record carries its own num_groups, so a configuration can be decoded on its own.
+// Chunks are written whole, so a file cut short by a crash still reads up to its last
+// complete chunk.
+//
+
+#ifndef HCP_SAMPLE_FILE_H
+#define HCP_SAMPLE_FILE_H
+
+#include "spsc_queue.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct sample_record {
+    long long itr;
+    double loglike;
+    int num_groups;
+    std::vector<uint64_t> g; // group states in hierarchy order, (num_groups+63)/64 words per node
+    std::vector<long long> group_size;
+    std::vector<long long> hcg_edges;
+    std::vector<long long> hcg_pairs;
+};
+
+class sample_writer {
+
+    private:
+        std::FILE *_file;
+        std::size_t _num_nodes;
+        std::size_t _records_per_chunk;
+        spsc_queue<sample_record> _queue;
+        std::vector<unsigned char> _chunk; // encoded records waiting to be written
+        std::size_t _chunk_records;
+        std::atomic<bool> _closing;
+        std::atomic<long> _flush_requests;
+        std::atomic<long> _flushes_done;
+        std::atomic<uint64_t> _offset; // bytes on disk after the last flush
+        std::string _path;
+        bool _write_failed; // set by the writer thread, which then writes nothing more
+        std::thread _thread;
+
+        void work();
+        void encode(const sample_record &record);
+        void write_chunk();
+
+    public:
+        // with a resume offset, an existing file is cut back to that many bytes and
+        // appended to, dropping anything written after the checkpoint it came from.
+        // Every queued record holds max_num_groups bits per node in 64-bit words, so the
+        // queue and the chunk are sized to stay within about queue_bytes and chunk_bytes
+        // for states of up to max_num_groups groups, keeping at least 2 records queued and 1
+        // per chunk on large networks.
+        sample_writer(const std::filesystem::path &path, std::size_t num_nodes, int max_num_groups,
+                      uint64_t resume_offset = 0, std::size_t queue_bytes = 64<<20,
+                      std::size_t chunk_bytes = 32<<20);
+        ~sample_writer();
+        sample_writer(const sample_writer&) = delete;
+        sample_writer& operator=(const sample_writer&) = delete;
+
+        // a record to fill in place and then publish(); called from the sampler thread
+        sample_record &acquire();
+        void publish();
+        // blocks until everything pushed so far is on disk and returns the file size
+        uint64_t flush();
+        // writes what is left and closes the file, returning false if any write failed,
+        // as on a full disk, in which case the samples from the failed chunk on are lost
+        bool close();
+};
+
+class sample_reader {
+
+    private:
+        std::FILE *_file;
+        std::size_t _num_nodes;
+        std::vector<unsigned char> _chunk;
+        std::size_t _pos;
+        std::size_t _records_left;
+
+        bool next_chunk();
+
+    public:
+        explicit sample_reader(const std::filesystem::path &path);
+        ~sample_reader();
+        sample_reader(const sample_reader&) = delete;
+        sample_reader& operator=(const sample_reader&) = delete;
+
+        bool good() const;
+        std::size_t num_nodes() const;
+        // reads the next record, returning false at the end of the file
+        bool next(sample_record &record);
+};
+
+// The decimal digits of the number held in words, least significant word first, which
+// is how the groups of a node are written to the text files
+std::string decimal_groups(const uint64_t *words, std::size_t size);
+
+// Writes the samples of a binary file as the *_configs.txt, *_num_groups.txt,
+// *_group_size.txt, *_edges.txt, *_pairs.txt and *_ll.txt text files.
+bool convert_samples_to_text(const std::filesystem::path &binary_path, const std::filesystem::path &filepath,
+                             const std::string &filename);
+
+#endif //HCP_SAMPLE_FILE_H
@@ -0,0 +1,44 @@
+//
+// Counters of the moves the sampler proposes and accepts, and the phase timers.
+//
+
+#include "sampler_stats.h"
+
+const char *move_kind_name(move_kind kind) {
+    switch (kind){
+        case move_kind::node_add: return "node_add";
+        case move_kind::node_remove: return "node_remove";
+        case move_kind::group_add: return "group_add";
+        case move_kind::group_remove: return "group_remove";
+        case move_kind::no_op: return "no_op";
+        case move_kind::heat_bath: return "heat_bath";
+    }
+    return "unknown";
+}
+
+const char *move_phase_name(move_phase phase) {
+    switch (phase){
+        case move_phase::propose: return "propose";
+        case move_phase::update_hcg_props: return "update_hcg_props";
+        case move_phase::calc_loglike: return "calc_loglike";
+        case move_phase::accept_reject: return "accept_reject";
+        case move_phase::heat_bath: return "heat_bath";
+    }
+    return "unknown";
+}
+
+bool timers_enabled() {
+#ifdef HCP_TIMERS
+    return true;
+#else
+    return false;
+#endif
+}
+
+const char *timer_unit() {
+#ifdef HCP_CYCLE_COUNTER
+    return "cycles";
+#else
+    return "ns";
+#endif
+}
@@ -0,0 +1,87 @@
+//
+// Counters of the moves the sampler proposes and accepts, by kind, and optionally the
+// time spent in each phase of a move. The counters cost an increment per step and are
+// always kept. The timers read the CPU's cycle counter (a nanosecond clock where there
+// is none) at every phase boundary, which costs more than some moves, so they are only
+// compiled in with -DHCP_TIMERS=ON. Chains write both out as JSON lines every
+// stats_interval iterations.
+//
+
+#ifndef HCP_SAMPLER_STATS_H
+#define HCP_SAMPLER_STATS_H
+
+#include <chrono>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HCP_CYCLE_COUNTER
+#endif
+
+enum class move_kind {
+    node_add,     // a node joins a group
+    node_remove,  // a node leaves a group
+    group_add,    // an empty group is inserted
+    group_remove, // an empty group is removed
+    no_op,        // the step picked a full or empty group, or had no group to add or change
+    heat_bath     // a heat-bath move of all of a node's groups, accepted if they changed
+};
+const int NUM_MOVE_KINDS = 6;
+
+enum class move_phase {
+    propose,          // drawing the move and editing the state and node lists
+    update_hcg_props, // counting the pairs and edges that change level
+    calc_loglike,     // the change in log-likelihood of the touched levels
+    accept_reject,    // the acceptance draw and keeping or undoing the move
+    heat_bath         // whole heat-bath moves
+};
+const int NUM_MOVE_PHASES = 5;
+
+const char *move_kind_name(move_kind kind);
+const char *move_phase_name(move_phase phase);
+
+// whether the timers are compiled in, and the unit they count in
+bool timers_enabled();
+const char *timer_unit();
+
+inline uint64_t read_cycles() {
+#ifdef HCP_CYCLE_COUNTER
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+struct sampler_stats {
+    long long proposed[NUM_MOVE_KINDS] = {};
+    long long accepted[NUM_MOVE_KINDS] = {};
+    uint64_t cycles[NUM_MOVE_PHASES] = {};
+
+    void count(move_kind kind, bool accept) {
+        proposed[static_cast<int>(kind)]++;
+        accepted[static_cast<int>(kind)] += accept;
+    }
+    void clear() { *this = sampler_stats(); }
+};
+
+// Charges the time since it was made, or since its last lap, to a phase of the move.
+// Without HCP_TIMERS it does nothing and compiles away.
+class phase_clock {
+#ifdef HCP_TIMERS
+    private:
+        uint64_t _last;
+
+    public:
+        phase_clock() : _last(read_cycles()) {}
+        void lap(sampler_stats &stats, move_phase phase) {
+            uint64_t now = read_cycles();
+            stats.cycles[static_cast<int>(phase)] += now - _last;
+            _last = now;
+        }
+#else
+    public:
+        void lap(sampler_stats &, move_phase) {}
+#endif
+};
+
+#endif //HCP_SAMPLER_STATS_H
@@ -0,0 +1,97 @@
+//
+// Measures how setting up the model scales. The network is read from a parameters file
+// as hcp does, and the model is built on the subnetworks induced by its first N/16,
+// N/8, ... N vertices, reporting the seconds each took. Then the counts of the full
+// network are redone with 1, 2, 4, ... setup threads up to the given maximum, reporting
+// the best time of a few repeats and the speedup for each. Only networks with at least
+// 2^20 adjacency entries count their edges on more than one thread.
+//
+// usage: hcp_setup_bench <parameters file> [max threads] [repeats]
+//
+
+#include "hierarchical_model.h"
+#include "graph_formats.h"
+#include "network_builder.h"
+#include "parameters.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 4){
+        std::cerr<<"usage: "<<argv[0]<<" <parameters file> [max threads] [repeats]"<<std::endl;
+        return EXIT_FAILURE;
+    }
+    parameters params(argv[1]);
+    if (params.get_error_status() == 1){
+        return EXIT_FAILURE;
+    }
+    int max_threads = (argc > 2) ? std::stoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+    int repeats = (argc > 3) ? std::stoi(argv[3]) : 3;
+
+    NETWORK network;
+    read_graph(&network, params.get_graph_path(), params.get_graph_format(), params.get_remap_node_ids(),
+               params.get_read_threads());
+    int n = network.nvertices;
+
+    std::cout<<"nodes\tedges\tseconds"<<std::endl;
+    thread_pool pool(params.get_read_threads());
+    for (int parts = 16; parts >= 1; parts /= 2){
+        int m = n/parts;
+        if (m < 1){
+            continue;
+        }
+        std::vector<index_edge> edges;
+        for (int u = 0; u < m; ++u){
+            for (int64_t e = network.offset[u]; e < network.offset[u+1]; ++e){
+                int v = network.target[e];
+                if (u < v && v < m){
+                    edges.push_back({u, v, 1.0});
+                }
+            }
+        }
+        NETWORK subnetwork;
+        build_adjacency(&subnetwork, m, 0, edges, pool);
+        std::vector<int64_t> ids(m);
+        std::iota(ids.begin(), ids.end(), 0);
+        set_vertex_ids(&subnetwork, ids);
+
+        auto start = std::chrono::steady_clock::now();
+        std::unique_ptr<hierarchical_model> model = make_width_model(params, subnetwork, params.get_seed());
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout<<m<<"\t"<<edges.size()<<"\t"<<seconds<<std::endl;
+        model.reset();
+        free_network(&subnetwork);
+    }
+
+    std::vector<int> counts;
+    for (int t = 1; t < max_threads; t *= 2){
+        counts.push_back(t);
+    }
+    counts.push_back(max_threads);
+
+    std::unique_ptr<hierarchical_model> model = make_width_model(params, network, params.get_seed());
+    std::vector<uint64_t> groups = model->get_g();
+    std::vector<double> best(counts.size(), 1e300);
+    for (std::size_t i = 0; i < counts.size(); ++i){
+        model->setup_threads = counts[i];
+        for (int r = 0; r < repeats; ++r){
+            auto start = std::chrono::steady_clock::now();
+            model->set_groups(groups, model->num_groups);
+            best[i] = std::min(best[i], std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+    }
+
+    std::cout<<"threads\tseconds\tspeedup"<<std::endl;
+    for (std::size_t i = 0; i < counts.size(); ++i){
+        std::cout<<counts[i]<<"\t"<<best[i]<<"\t"<<best[0]/best[i]<<std::endl;
+    }
+    free_network(&network);
+    return 0;
+}
@@ -0,0 +1,60 @@
+//
+// Lock-free single-producer single-consumer ring of reusable slots.
+//
+
+#ifndef HCP_SPSC_QUEUE_H
+#define HCP_SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// The producer fills a slot in place between acquire() and publish(), and the consumer
+// reads it between front() and pop(), so slots are reused without ever being copied or
+// reallocated.
+template <typename T>
+class spsc_queue {
+
+    private:
+        std::vector<T> _slots;
+        alignas(64) std::atomic<std::size_t> _head; // next slot to consume
+        alignas(64) std::atomic<std::size_t> _tail; // next slot to fill
+
+    public:
+        explicit spsc_queue(std::size_t capacity)
+            : _slots(capacity), _head(0), _tail(0) {}
+
+        std::size_t capacity() const { return _slots.size(); }
+
+        // producer side: a free slot to fill, or nullptr if the queue is full
+        T* acquire() {
+            std::size_t tail = _tail.load(std::memory_order_relaxed);
+            if (tail - _head.load(std::memory_order_acquire) == _slots.size()){
+                return nullptr;
+            }
+            return &_slots[tail % _slots.size()];
+        }
+
+        void publish() {
+            _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        // consumer side: the oldest filled slot, or nullptr if the queue is empty
+        T* front() {
+            std::size_t head = _head.load(std::memory_order_relaxed);
+            if (head == _tail.load(std::memory_order_acquire)){
+                return nullptr;
+            }
+            return &_slots[head % _slots.size()];
+        }
+
+        void pop() {
+            _head.store(_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        bool empty() const {
+            return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+        }
+};
+
+#endif //HCP_SPSC_QUEUE_H
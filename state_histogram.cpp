@@ -0,0 +1,107 @@
+//
+// Histogram of the distinct group states held by the nodes.
+//
+
+#include "state_histogram.h"
+#include <cassert>
+
+template <typename state_t>
+state_histogram<state_t>::state_histogram()
+    : _table(1, -1), _mask(0) {}
+
+template <typename state_t>
+void state_histogram<state_t>::reserve(std::size_t max_states) {
+    std::size_t capacity = 1;
+    while (capacity < 2*max_states){
+        capacity <<= 1;
+    }
+    _states.reserve(max_states);
+    _counts.reserve(max_states);
+    _table.assign(capacity, -1);
+    _mask = capacity-1;
+    for (std::size_t i = 0; i < _states.size(); ++i){
+        _table[slot_of(_states[i])] = i;
+    }
+}
+
+template <typename state_t>
+void state_histogram<state_t>::clear() {
+    _states.clear();
+    _counts.clear();
+    std::fill(_table.begin(), _table.end(), -1);
+}
+
+template <typename state_t>
+inline std::size_t state_histogram<state_t>::home(const state_t &state) const {
+    return ((state_key(state)*0x9E3779B97F4A7C15ULL)>>32)&_mask;
+}
+
+// Returns the slot holding state, or the empty slot where it would be inserted.
+template <typename state_t>
+inline std::size_t state_histogram<state_t>::slot_of(const state_t &state) const {
+    std::size_t slot = home(state);
+    while (_table[slot] != -1 && _states[_table[slot]] != state){
+        slot = (slot+1)&_mask;
+    }
+    return slot;
+}
+
+template <typename state_t>
+void state_histogram<state_t>::add(state_t state) {
+    std::size_t slot = slot_of(state);
+    if (_table[slot] == -1){
+        assert(_states.size() < _states.capacity());
+        _table[slot] = _states.size();
+        _states.push_back(state);
+        _counts.push_back(1);
+    }else{
+        _counts[_table[slot]]++;
+    }
+}
+
+template <typename state_t>
+void state_histogram<state_t>::remove(state_t state) {
+    std::size_t slot = slot_of(state);
+    assert(_table[slot] != -1);
+    std::size_t idx = _table[slot];
+    if (--_counts[idx] > 0){
+        return;
+    }
+
+    // backward shift deletion keeps every probe sequence unbroken
+    std::size_t hole = slot;
+    std::size_t next = (hole+1)&_mask;
+    while (_table[next] != -1){
+        std::size_t h = home(_states[_table[next]]);
+        if (((next-h)&_mask) >= ((next-hole)&_mask)){
+            _table[hole] = _table[next];
+            hole = next;
+        }
+        next = (next+1)&_mask;
+    }
+    _table[hole] = -1;
+
+    // move the last state into the freed index so _states stays dense
+    std::size_t last = _states.size()-1;
+    if (idx != last){
+        _table[slot_of(_states[last])] = idx;
+        _states[idx] = _states[last];
+        _counts[idx] = _counts[last];
+    }
+    _states.pop_back();
+    _counts.pop_back();
+}
+
+template <typename state_t>
+void state_histogram<state_t>::move(state_t old_state, state_t new_state) {
+    remove(old_state);
+    add(new_state);
+}
+
+template class state_histogram<uint8_t>;
+template class state_histogram<uint16_t>;
+template class state_histogram<uint32_t>;
+template class state_histogram<uint64_t>;
+template class state_histogram<wide_state<2>>;
+template class state_histogram<wide_state<4>>;
+template class state_histogram<wide_state<8>>;
@@ -0,0 +1,47 @@
+//
+// Histogram of the distinct group states held by the nodes, for states of type state_t
+// (instantiated for the unsigned integer widths and the wide states in
+// state_histogram.cpp).
+//
+
+#ifndef HCP_STATE_HISTOGRAM_H
+#define HCP_STATE_HISTOGRAM_H
+
+#include "group_state.h"
+#include <cstdint>
+#include <vector>
+
+template <typename state_t>
+class state_histogram {
+
+    private:
+        std::vector<state_t> _states; // distinct states, kept dense
+        std::vector<long long> _counts; // number of nodes holding each state
+        std::vector<int> _table; // open addressing table of indices into _states, -1 if empty
+        std::size_t _mask;
+
+        std::size_t slot_of(const state_t &state) const;
+        std::size_t home(const state_t &state) const;
+
+    public:
+        state_histogram();
+
+        // allocates room for up to max_states distinct states so add/remove never allocate
+        void reserve(std::size_t max_states);
+        void clear();
+
+        void add(state_t state);
+        void remove(state_t state);
+        void move(state_t old_state, state_t new_state);
+
+        std::size_t size() const { return _states.size(); }
+        state_t state(std::size_t i) const { return _states[i]; }
+        long long count(std::size_t i) const { return _counts[i]; }
+        // the distinct states and their counts as contiguous arrays of size()
+        const state_t *states() const { return _states.data(); }
+        const long long *counts() const { return _counts.data(); }
+
+};
+
+
+#endif //HCP_STATE_HISTOGRAM_H
@@ -0,0 +1,108 @@
+//
+// Work-stealing thread pool used to run independent sampler chains.
+//
+
+#include "thread_pool.h"
+
+thread_pool::thread_pool(std::size_t num_threads)
+    : _pending(0), _next_queue(0), _stopping(false) {
+    if (num_threads == 0){
+        num_threads = 1;
+    }
+    for (std::size_t i = 0; i < num_threads; ++i){
+        _queues.push_back(std::make_unique<worker_queue>());
+    }
+    for (std::size_t i = 0; i < num_threads; ++i){
+        _workers.emplace_back(&thread_pool::work, this, i);
+    }
+}
+
+thread_pool::~thread_pool() {
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _stopping = true;
+    }
+    _wake.notify_all();
+    for (auto& worker : _workers){
+        worker.join();
+    }
+}
+
+void thread_pool::submit(std::function<void()> task) {
+    std::size_t q = _next_queue++ % _queues.size();
+    {
+        std::lock_guard<std::mutex> guard(_queues[q]->lock);
+        _queues[q]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _pending++;
+    }
+    _wake.notify_all();
+}
+
+// Takes the newest task from the worker's own queue, or else steals the oldest task
+// from another worker's queue.
+bool thread_pool::pop_task(std::size_t worker, std::function<void()>& task) {
+    {
+        worker_queue& own = *_queues[worker];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tasks.empty()){
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (std::size_t i = 1; i < _queues.size(); ++i){
+        worker_queue& other = *_queues[(worker + i) % _queues.size()];
+        std::lock_guard<std::mutex> guard(other.lock);
+        if (!other.tasks.empty()){
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void thread_pool::work(std::size_t worker) {
+    std::function<void()> task;
+    while (true){
+        if (pop_task(worker, task)){
+            task();
+            task = nullptr;
+            std::lock_guard<std::mutex> guard(_lock);
+            if (--_pending == 0){
+                _idle.notify_all();
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(_lock);
+        if (_stopping){
+            return;
+        }
+        // tasks are counted in _pending before the wake-up, so a task queued after our
+        // failed pop is never missed
+        _wake.wait(guard, [this]{
+            if (_stopping){
+                return true;
+            }
+            for (auto& q : _queues){
+                std::lock_guard<std::mutex> qguard(q->lock);
+                if (!q->tasks.empty()){
+                    return true;
+                }
+            }
+            return false;
+        });
+    }
+}
+
+void thread_pool::wait() {
+    std::unique_lock<std::mutex> guard(_lock);
+    _idle.wait(guard, [this]{ return _pending == 0; });
+}
+
+std::size_t thread_pool::size() const {
+    return _workers.size();
+}
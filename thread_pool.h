@@ -0,0 +1,68 @@
+//
+// Work-stealing thread pool used to run independent sampler chains.
+//
+
+#ifndef HCP_THREAD_POOL_H
+#define HCP_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class thread_pool {
+
+    private:
+        struct worker_queue {
+            std::mutex lock;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        std::vector<std::unique_ptr<worker_queue>> _queues;
+        std::vector<std::thread> _workers;
+        std::mutex _lock;
+        std::condition_variable _wake;
+        std::condition_variable _idle;
+        std::atomic<long> _pending;
+        std::atomic<std::size_t> _next_queue;
+        bool _stopping;
+
+        bool pop_task(std::size_t worker, std::function<void()>& task);
+        void work(std::size_t worker);
+
+    public:
+        explicit thread_pool(std::size_t num_threads);
+        ~thread_pool();
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        // queues a task on the next worker in turn; idle workers steal from busy ones
+        void submit(std::function<void()> task);
+        // blocks until every submitted task has finished
+        void wait();
+
+        std::size_t size() const;
+};
+
+// Splits [0, n) into one contiguous range per worker, runs f(begin, end) on each and
+// waits for all of them
+template <typename F>
+void parallel_ranges(thread_pool &pool, std::size_t n, F f) {
+    std::size_t parts = pool.size();
+    for (std::size_t p = 0; p < parts; ++p){
+        std::size_t begin = n*p/parts;
+        std::size_t end = n*(p+1)/parts;
+        if (begin < end){
+            pool.submit([&f, begin, end]() { f(begin, end); });
+        }
+    }
+    pool.wait();
+}
+
+
+#endif //HCP_THREAD_POOL_H